@@ -1,6 +1,10 @@
+#define _GNU_SOURCE
+
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
@@ -11,6 +15,8 @@
 #include <errno.h>
 
 #define CHUNK_SIZE sysconf(_SC_PAGESIZE)         /* chunk size in bytes */
+#define UNIT_SIZE 5             /* a zip unit as written: 4 byte count, then character */
+#define COPY_SIZE (128 << 10)   /* buffer size when the kernel can't copy for us */
 
 #define handle_error(msg)                               \
     do { perror(msg); exit(EXIT_FAILURE); } while (0)
@@ -61,12 +67,25 @@ void *output_zip_data(void *);
 
 zip_unit*  output_chunk(zip_chunk *, zip_unit *);
 
+void append_zip_files(const char *, char **, int);
+
 int main(int argc, char *argv[]) {
     if (argc <= 1) {
         printf("pzip: file1 [file2 ...]\n");
         exit(EXIT_FAILURE);
     }
 
+    if (strcmp(argv[1], "--append") == 0) {
+        /* pzip --append archive.z file1.z [file2.z ...] */
+        if (argc <= 3) {
+            printf("pzip: --append archive file1 [file2 ...]\n");
+            exit(EXIT_FAILURE);
+        }
+
+        append_zip_files(argv[2], &argv[3], argc - 3);
+        return EXIT_SUCCESS;
+    }
+
     struct stat statbuf;
     int fd, nthreads, worker, procs;
     char *fp;
@@ -288,3 +307,219 @@ zip_unit* output_chunk(zip_chunk *chunk, zip_unit *prev) {
 
     return &units[size - 1];
 }
+
+
+static zip_unit read_unit(int fd, off_t offset) {
+    unsigned char buf[UNIT_SIZE];
+    zip_unit unit;
+
+    if (pread(fd, buf, UNIT_SIZE, offset) != UNIT_SIZE) {
+        handle_error("pread");
+    }
+
+    memcpy(&unit.count, buf, sizeof(unit.count));
+    unit.c = buf[4];
+    return unit;
+}
+
+
+static void write_unit(int fd, zip_unit unit, off_t offset) {
+    unsigned char buf[UNIT_SIZE];
+
+    memcpy(buf, &unit.count, sizeof(unit.count));
+    buf[4] = unit.c;
+
+    if (pwrite(fd, buf, UNIT_SIZE, offset) != UNIT_SIZE) {
+        handle_error("pwrite");
+    }
+}
+
+
+/* copies len bytes at offset of in to *out_offset of out, moving it along */
+static void copy_units(int in, off_t offset, int out, off_t *out_offset, size_t len) {
+    static char buffer[COPY_SIZE];
+
+    while (len > 0) {
+        ssize_t n = copy_file_range(in, &offset, out, out_offset, len, 0);
+
+        if (n > 0) {
+            len -= n;
+            continue;
+        }
+
+        if (n == -1 && errno == EINTR) continue;
+
+        if (n == 0 || (errno != EINVAL && errno != EXDEV && errno != ENOSYS &&
+                       errno != EOPNOTSUPP)) {
+            handle_error("copy_file_range");
+        }
+
+        /* no copy_file_range() between these files; copy the rest by hand */
+        while (len > 0) {
+            n = pread(in, buffer, (len < COPY_SIZE) ? len : COPY_SIZE, offset);
+            if (n <= 0) {
+                handle_error("pread");
+            }
+
+            if (pwrite(out, buffer, n, *out_offset) != n) {
+                handle_error("pwrite");
+            }
+
+            offset += n;
+            *out_offset += n;
+            len -= n;
+        }
+    }
+}
+
+
+/* size of a zip file, or -1 if it isn't a whole number of units */
+static off_t zip_size(int fd, const char *name) {
+    struct stat statbuf;
+
+    if (fstat(fd, &statbuf) == -1) {
+        handle_error("fstat");
+    }
+
+    if (!S_ISREG(statbuf.st_mode) || statbuf.st_size % UNIT_SIZE != 0) {
+        fprintf(stderr, "pzip: %s: not a zip file\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    return statbuf.st_size;
+}
+
+
+/* the archive --append is writing to, and its size before; -1 once it's done */
+static int append_fd = -1;
+static off_t append_size;
+
+
+/* puts the archive back the way it was when --append fails halfway */
+static void undo_append() {
+    if (append_fd != -1 && ftruncate(append_fd, append_size) == -1) {
+        perror("ftruncate");
+    }
+}
+
+
+/**
+ * Writes a unit to the archive being appended to, and moves *end along. The
+ * units written all go past the old archive, except for one in the slot of
+ * its last unit: that one is kept in *held instead, and written last.
+ **/
+static void put_unit(int out, zip_unit unit, off_t *end, zip_unit *held, bool *holding) {
+    if (*end < append_size) {
+        *held = unit;
+        *holding = true;
+    } else {
+        write_unit(out, unit, *end);
+    }
+
+    *end += UNIT_SIZE;
+}
+
+
+/**
+ * Appends the zip files to the archive without unzipping anything. The only
+ * units that need looking at are the ones where two files meet: when the
+ * last unit so far and the first one of the next file have the same
+ * character, they become a single unit, just as if the data had been zipped
+ * together. Everything in between is copied with copy_file_range(), so each
+ * file costs the same no matter how big it is.
+ *
+ * The archive's own units stay as they are until everything else has been
+ * written, and the one that can change (its last) is written last of all.
+ * If anything fails before that, the archive is cut back to its old size.
+ **/
+void append_zip_files(const char *archive, char **files, int nfiles) {
+    int out = open(archive, O_RDWR | O_CREAT, 0644);
+    if (out == -1) {
+        handle_error("open");
+    }
+
+    off_t size = zip_size(out, archive);
+    off_t end = 0;              /* where the last unit so far goes */
+    zip_unit last = { 0, 0 };   /* the last unit, held back in case the next file continues it */
+    bool have_last = false;
+    off_t slot;                 /* where the archive's last unit was */
+    zip_unit held;              /* the unit that goes there instead */
+    bool holding = false;
+
+    append_fd = out;
+    append_size = size;
+    atexit(undo_append);
+
+    /* an archive of empty input is a single empty unit; there's nothing to keep */
+    if (size > 0) {
+        last = read_unit(out, size - UNIT_SIZE);
+        have_last = (size > UNIT_SIZE || last.count > 0);
+        end = have_last ? size - UNIT_SIZE : 0;
+    }
+
+    slot = end;
+
+    for (int i = 0; i < nfiles; i++) {
+        int fd = open(files[i], O_RDONLY);
+        if (fd == -1) {
+            handle_error("open");
+        }
+
+        size = zip_size(fd, files[i]);
+        if (size == 0) {
+            close(fd);
+            continue;
+        }
+
+        zip_unit first = read_unit(fd, 0);
+        off_t from = 0;
+
+        if (size == UNIT_SIZE && first.count == 0) {
+            /* empty input */
+            close(fd);
+            continue;
+        }
+
+        if (have_last && last.c == first.c && (int64_t) last.count + first.count <= INT32_MAX) {
+            /* the run goes on across the boundary; make it a single unit */
+            first.count += last.count;
+            from = UNIT_SIZE;
+
+            if (size == UNIT_SIZE) {
+                /* the whole file was that run, and the next may continue it */
+                last = first;
+                close(fd);
+                continue;
+            }
+
+            put_unit(out, first, &end, &held, &holding);
+        } else if (have_last) {
+            put_unit(out, last, &end, &held, &holding);
+        }
+
+        last = read_unit(fd, size - UNIT_SIZE);
+        have_last = true;
+        copy_units(fd, from, out, &end, size - UNIT_SIZE - from);
+
+        close(fd);
+    }
+
+    if (!have_last) {
+        /* still nothing but empty input */
+        last.count = 0;
+        last.c = 0;
+    }
+
+    put_unit(out, last, &end, &held, &holding);
+
+    /* the archive only ever grows, so this cuts nothing of its own */
+    if (ftruncate(out, end) == -1) {
+        handle_error("ftruncate");
+    }
+
+    if (holding) write_unit(out, held, slot);
+
+    /* done; nothing to undo any more */
+    append_fd = -1;
+    close(out);
+}
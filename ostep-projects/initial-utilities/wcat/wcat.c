@@ -1,26 +1,185 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define BUFFER_SIZE (128 << 10)     /* read()/write() size for the fallback */
+#define KERNEL_CHUNK (1 << 30)      /* bytes asked of the kernel per call */
+#define PREFETCH_DEPTH 16           /* files opened ahead of the one copied */
+
+/* how the data gets from a file to standard output */
+typedef enum {
+    COPY_RANGE,     /* copy_file_range(): file to file, possibly just extents */
+    COPY_SPLICE,    /* splice(): anything into a pipe, through its pages */
+    COPY_SENDFILE,  /* sendfile(): a file's page cache to a socket or file */
+    COPY_BUFFER     /* read() and write() through a buffer of our own */
+} method_t;
+
+
+static void fail(const char *msg) {
+    printf("%s", msg);
+    exit(EXIT_FAILURE);
+}
+
+
+/* picks the fastest way to copy a file to stdout that is worth a try */
+static method_t choose_method(const struct stat *in, const struct stat *out) {
+    /**
+     * A regular file with no size may still have data (files in /proc and
+     * /sys), which only read() is sure to return.
+     **/
+    bool in_file = S_ISREG(in->st_mode) && in->st_size > 0;
+    bool in_stream = S_ISFIFO(in->st_mode) || S_ISSOCK(in->st_mode);
+
+    if (S_ISFIFO(out->st_mode) && (in_file || in_stream)) return COPY_SPLICE;
+    if (in_file && S_ISREG(out->st_mode)) return COPY_RANGE;
+    if (in_file) return COPY_SENDFILE;
+
+    return COPY_BUFFER;
+}
+
+
+/**
+ * Moves data from fd to stdout without it passing through user space.
+ * Returns false if the kernel can't do that for this pair of descriptors;
+ * whatever was copied by then has moved both file offsets along, so the
+ * fallback carries on where this left off.
+ **/
+static bool copy_kernel(int fd, method_t method) {
+    bool first = true;
+    ssize_t n;
+
+    do {
+        switch (method) {
+            case COPY_RANGE:
+                n = copy_file_range(fd, NULL, STDOUT_FILENO, NULL, KERNEL_CHUNK, 0);
+                break;
+
+            case COPY_SPLICE:
+                n = splice(fd, NULL, STDOUT_FILENO, NULL, KERNEL_CHUNK, SPLICE_F_MOVE);
+                break;
+
+            default:
+                n = sendfile(STDOUT_FILENO, fd, NULL, KERNEL_CHUNK);
+                break;
+        }
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+
+            /* unsupported for these files (e.g. across file systems) */
+            if (first && (errno == EINVAL || errno == EXDEV || errno == ENOSYS ||
+                          errno == EOPNOTSUPP || errno == EBADF)) {
+                return false;
+            }
+
+            fail("wcat: cannot write file\n");
+        }
+
+        first = false;
+    } while (n != 0);
+
+    return true;
+}
+
+
+/* copies fd to stdout through a buffer */
+static void copy_buffer(int fd) {
+    static char buffer[BUFFER_SIZE];
+    ssize_t n;
+
+    while ((n = read(fd, buffer, BUFFER_SIZE)) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            fail("wcat: cannot read file\n");
+        }
+
+        for (ssize_t done = 0; done < n; ) {
+            ssize_t written = write(STDOUT_FILENO, buffer + done, n - done);
+
+            if (written == -1) {
+                if (errno == EINTR) continue;
+                fail("wcat: cannot write file\n");
+            }
+
+            done += written;
+        }
+    }
+}
+
+
+/**
+ * Opens a file before its turn, and asks the kernel to start reading it in
+ * (posix_fadvise() returns straight away), so that its data is on the way
+ * while the files before it are copied. Only regular files are opened
+ * ahead: opening a FIFO or a device can block or have side effects, so
+ * those, and any file that fails to open here, are opened again in turn,
+ * which is also where an error gets reported. Returns the descriptor, or
+ * -1 if the file is left for later.
+ **/
+static int open_ahead(const char *name) {
+    struct stat st;
+    int fd = open(name, O_RDONLY | O_NONBLOCK);
+
+    if (fd == -1) return -1;
+
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    /* O_NONBLOCK was only there for the open; splice() would honour it */
+    fcntl(fd, F_SETFL, 0);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    return fd;
+}
+
 
 int main(int argc, char *argv[]) {
 
     if (argc <= 1) exit(EXIT_SUCCESS);
 
-    const int BUFFER_LENGTH = 256;
-    char buffer[BUFFER_LENGTH];
+    struct stat out_stat;
+    bool out_known = (fstat(STDOUT_FILENO, &out_stat) == 0);
 
-    // for each fiel in the given arglist
+    /* descriptors of the files opened ahead, by argument index */
+    int window[PREFETCH_DEPTH];
+    int opened = 1;
+
+    // for each file in the given arglist
     for (int i = 1; i < argc; i++) {
-        FILE *fp = fopen(argv[i], "r");
-        if (fp == NULL) {
-            printf("wcat: cannot open file\n");
-            exit(EXIT_FAILURE);
+        for (; opened < argc && opened < i + PREFETCH_DEPTH; opened++) {
+            window[opened % PREFETCH_DEPTH] = open_ahead(argv[opened]);
         }
-        while (fgets(buffer, BUFFER_LENGTH, fp)) {
-            printf("%s", buffer);
+
+        int fd = window[i % PREFETCH_DEPTH];
+
+        if (fd == -1) {
+            fd = open(argv[i], O_RDONLY);
+        }
+
+        if (fd == -1) {
+            fail("wcat: cannot open file\n");
         }
-        if (fclose(fp) != 0) {
-            printf("wcat: cannot close file\n");
-            exit(EXIT_FAILURE);
+
+        struct stat in_stat;
+        method_t method = COPY_BUFFER;
+
+        if (out_known && fstat(fd, &in_stat) == 0) {
+            method = choose_method(&in_stat, &out_stat);
+        }
+
+        if (method == COPY_BUFFER || !copy_kernel(fd, method)) {
+            copy_buffer(fd);
+        }
+
+        if (close(fd) != 0) {
+            fail("wcat: cannot close file\n");
         }
     }
 
@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "aho.h"
+
+#define ACCEPT 0x80000000u      /* marks transitions into matching states */
+#define ROW_MASK 0x7fffffffu    /* strips the accept bit off a transition */
+
+
+/* adds an empty state to the table; returns its row offset, or -1 on failure */
+static long add_state(aho_t *a, size_t *cap) {
+    if (a->num_states == *cap) {
+        size_t new_cap = (*cap == 0) ? 64 : *cap * 2;
+        uint32_t *tmp = realloc(a->delta, sizeof(uint32_t) * new_cap * a->num_classes);
+
+        if (tmp == NULL) {
+            /* realloc failed */
+            return -1;
+        }
+
+        a->delta = tmp;
+        *cap = new_cap;
+    }
+
+    long row = a->num_states++ * a->num_classes;
+    memset(&a->delta[row], 0, sizeof(uint32_t) * a->num_classes);
+
+    return row;
+}
+
+
+aho_t *aho_build(char **patterns, size_t *lengths, size_t num, bool icase) {
+    aho_t *a = malloc(sizeof(aho_t));
+
+    if (a == NULL) {
+        /* malloc failed */
+        return NULL;
+    }
+
+    a->delta = NULL;
+    a->num_states = 0;
+    a->empty_match = false;
+
+    /* give every byte used by a pattern its own class; the rest share class 0 */
+    memset(a->classes, 0, sizeof(a->classes));
+    a->num_classes = 1;
+
+    for (size_t i = 0; i < num; i++) {
+        for (size_t j = 0; j < lengths[i]; j++) {
+            unsigned char c = patterns[i][j];
+            if (icase && c >= 'A' && c <= 'Z') c |= 0x20;
+            if (a->classes[c] == 0) a->classes[c] = a->num_classes++;
+        }
+    }
+
+    if (icase) {
+        /* upper case letters take the class of their lower case twin */
+        for (int c = 'A'; c <= 'Z'; c++) {
+            a->classes[c] = a->classes[c | 0x20];
+        }
+    }
+
+    size_t nc = a->num_classes;
+    size_t cap = 0;
+    bool *accepting = NULL;
+    uint32_t *fail = NULL, *queue = NULL;
+
+    if (add_state(a, &cap) == -1) goto fail;
+
+    /* build the trie; a zero entry means "no edge" since nothing points at the root */
+    for (size_t i = 0; i < num; i++) {
+        uint32_t row = 0;
+
+        if (lengths[i] == 0) a->empty_match = true;
+
+        for (size_t j = 0; j < lengths[i]; j++) {
+            uint32_t *edge = &a->delta[row + a->classes[(unsigned char) patterns[i][j]]];
+
+            if (*edge == 0) {
+                long new_row = add_state(a, &cap);
+                if (new_row == -1) goto fail;
+
+                /* the table may have moved */
+                edge = &a->delta[row + a->classes[(unsigned char) patterns[i][j]]];
+                *edge = new_row;
+            }
+
+            row = *edge;
+        }
+    }
+
+    accepting = calloc(a->num_states, sizeof(bool));
+    fail = malloc(sizeof(uint32_t) * a->num_states);
+    queue = malloc(sizeof(uint32_t) * a->num_states);
+
+    if (accepting == NULL || fail == NULL || queue == NULL) goto fail;
+
+    /* walk every pattern again to flag the states that complete one */
+    for (size_t i = 0; i < num; i++) {
+        uint32_t row = 0;
+
+        for (size_t j = 0; j < lengths[i]; j++) {
+            row = a->delta[row + a->classes[(unsigned char) patterns[i][j]]];
+        }
+
+        if (lengths[i] > 0) accepting[row / nc] = true;
+    }
+
+    /* breadth-first pass to turn the trie into a DFA: missing edges borrow the
+     * transition of the failure state, which is always nearer the root and so
+     * already complete */
+    size_t head = 0, tail = 0;
+
+    for (size_t c = 0; c < nc; c++) {
+        uint32_t child = a->delta[c];
+
+        if (child != 0) {
+            fail[child / nc] = 0;
+            queue[tail++] = child;
+        }
+    }
+
+    while (head < tail) {
+        uint32_t row = queue[head++];
+        uint32_t fail_row = fail[row / nc];
+
+        /* a state completes a pattern if anything along its failure chain does */
+        if (accepting[fail_row / nc]) accepting[row / nc] = true;
+
+        for (size_t c = 0; c < nc; c++) {
+            uint32_t child = a->delta[row + c];
+
+            if (child != 0) {
+                fail[child / nc] = a->delta[fail_row + c];
+                queue[tail++] = child;
+            } else {
+                a->delta[row + c] = a->delta[fail_row + c];
+            }
+        }
+    }
+
+    /* finally, fold the accept flags into the transitions themselves */
+    for (size_t i = 0; i < a->num_states * nc; i++) {
+        if (accepting[a->delta[i] / nc]) a->delta[i] |= ACCEPT;
+    }
+
+    free(accepting);
+    free(fail);
+    free(queue);
+
+    return a;
+
+fail:
+    free(accepting);
+    free(fail);
+    free(queue);
+    aho_free(a);
+    return NULL;
+}
+
+
+void aho_free(aho_t *a) {
+    if (a == NULL) return;
+
+    free(a->delta);
+    free(a);
+}
+
+
+const char *aho_find(const aho_t *a, const char *start, const char *end) {
+    if (a->empty_match) return (start < end) ? start : NULL;
+
+    const uint32_t *delta = a->delta;
+    const uint8_t *classes = a->classes;
+    uint32_t row = 0;
+
+    for (const unsigned char *p = (const unsigned char *) start;
+         p < (const unsigned char *) end; p++) {
+        row = delta[row + classes[*p]];
+
+        if (row & ACCEPT) return (const char *) p;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,42 @@
+#ifndef AHO_H_
+#define AHO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * An Aho-Corasick automaton over a set of patterns, compiled down to a full
+ * DFA so that matching is a single table lookup per input byte.
+ *
+ * Bytes that appear in no pattern all behave the same, so the input alphabet
+ * is first squeezed into equivalence classes. The transition table is one
+ * flat array with a row of `num_classes` entries per state. Entries hold the
+ * offset of the next state's row, with the top bit set when that state
+ * completes a pattern.
+ **/
+typedef struct {
+    uint32_t *delta;            /* the flat transition table */
+    size_t   num_states;        /* number of states (rows) in the table */
+    size_t   num_classes;       /* number of byte classes (columns) */
+    uint8_t  classes[256];      /* byte to class map */
+    bool     empty_match;       /* an empty pattern matches everywhere */
+} aho_t;
+
+
+/**
+ * Builds the automaton for the given patterns; with icase set, ASCII letters
+ * match either case (both cases simply share a byte class). Returns NULL if
+ * memory could not be allocated.
+ **/
+aho_t *aho_build(char **patterns, size_t *lengths, size_t num, bool icase);
+
+void aho_free(aho_t*);
+
+/**
+ * Returns a pointer to the last byte of the first pattern occurrence found in
+ * [start, end), or NULL if there isn't one.
+ **/
+const char *aho_find(const aho_t*, const char *start, const char *end);
+
+#endif // AHO_H_
@@ -0,0 +1,763 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "index.h"
+#include "scan.h"
+#include "search.h"
+#include "output.h"
+
+#define INDEX_NAME   ".wgrep-index"     /* the index, inside the directory */
+#define INDEX_TEMP   ".wgrep-index.tmp" /* written first, then renamed over it */
+#define INDEX_MAGIC  "WGRPIDX1"
+
+#define BLOCK_SIZE   (64 << 10)         /* blocks end on the first newline past this */
+#define NUM_TRIGRAMS (1 << 24)
+
+/**
+ * The index file is laid out as the header, followed by the arrays of files,
+ * blocks, trigrams, and postings (block numbers), and finally the file names.
+ * Everything is 8 byte aligned so the arrays can be used straight from the
+ * mapping.
+ **/
+typedef struct {
+    char     magic[8];
+    uint64_t num_files;
+    uint64_t num_blocks;
+    uint64_t num_trigrams;
+    uint64_t num_postings;
+    uint64_t names_size;
+} idx_header;
+
+typedef struct {
+    uint64_t name;              /* offset of the file's name in the names */
+    uint64_t size;              /* size of the file when it was indexed */
+    int64_t  mtime_sec;         /* its modification time back then */
+    int64_t  mtime_nsec;
+    uint64_t first_block;       /* a file's blocks are numbered consecutively */
+    uint64_t num_blocks;
+} idx_file;
+
+typedef struct {
+    uint64_t off;               /* where the block starts in its file */
+    uint64_t line;              /* lines in the file before the block */
+} idx_block;
+
+typedef struct {
+    uint32_t trigram;           /* the three bytes, first one highest */
+    uint32_t count;             /* number of blocks holding it */
+    uint64_t first;             /* where its blocks start in the postings */
+} idx_trigram;
+
+/* an index mapped from disk */
+typedef struct {
+    idx_header        header;
+    const idx_file    *files;
+    const idx_block   *blocks;
+    const idx_trigram *trigrams;
+    const uint32_t    *postings;
+    const char        *names;
+    void              *map;
+    size_t            map_size;
+} index_t;
+
+/* an index being built */
+typedef struct {
+    idx_file  *files;
+    size_t    num_files, files_cap;
+    idx_block *blocks;
+    size_t    num_blocks, blocks_cap;
+    uint64_t  *pairs;           /* trigram << 32 | block, sorted at the end */
+    size_t    num_pairs, pairs_cap;
+    char      *names;
+    size_t    names_size, names_cap;
+    uint8_t   *seen;            /* bitmap of the trigrams seen in a block */
+} builder_t;
+
+
+/* makes room for num + extra elements of a growable array */
+static void *grow(void *array, size_t *cap, size_t num, size_t extra, size_t size) {
+    if (num + extra <= *cap) return array;
+
+    size_t new_cap = (*cap == 0) ? 64 : *cap;
+    while (new_cap < num + extra) new_cap *= 2;
+
+    void *tmp = realloc(array, new_cap * size);
+
+    if (tmp == NULL) {
+        /* realloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    *cap = new_cap;
+    return tmp;
+}
+
+
+static char *join_path(const char *dir, const char *name) {
+    size_t len = strlen(dir);
+    char *path = malloc(len + strlen(name) + 2);
+
+    if (path == NULL) {
+        /* malloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    if (len > 0 && dir[len - 1] == '/') {
+        sprintf(path, "%s%s", dir, name);
+    } else {
+        sprintf(path, "%s/%s", dir, name);
+    }
+
+    return path;
+}
+
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+
+static int compare_pairs(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+static int compare_trigrams(const void *key, const void *entry) {
+    uint32_t t = *(const uint32_t *) key;
+    uint32_t e = ((const idx_trigram *) entry)->trigram;
+
+    return (t > e) - (t < e);
+}
+
+
+/* lists the regular files of the directory, sorted by name */
+static char **list_files(int dirfd, size_t *num) {
+    DIR *dp = fdopendir(dup(dirfd));
+    char **names = NULL;
+    size_t cap = 0;
+    struct dirent *ent;
+    struct stat statbuf;
+
+    *num = 0;
+
+    if (dp == NULL) {
+        out_error("wgrep: cannot open directory\n");
+    }
+
+    while ((ent = readdir(dp)) != NULL) {
+        /* skips ".", "..", the index itself, and other hidden files */
+        if (ent->d_name[0] == '.') continue;
+
+        if (ent->d_type != DT_REG) {
+            if (ent->d_type != DT_UNKNOWN && ent->d_type != DT_LNK) continue;
+
+            if (fstatat(dirfd, ent->d_name, &statbuf, 0) == -1 || !S_ISREG(statbuf.st_mode)) {
+                continue;
+            }
+        }
+
+        names = grow(names, &cap, *num, 1, sizeof(char *));
+        names[*num] = strdup(ent->d_name);
+
+        if (names[*num] == NULL) {
+            /* strdup failed */
+            out_error("wgrep: out of memory\n");
+        }
+
+        (*num)++;
+    }
+
+    closedir(dp);
+
+    if (*num > 1) qsort(names, *num, sizeof(char *), compare_names);
+    return names;
+}
+
+
+static void unmap_index(index_t *idx) {
+    if (idx->map != NULL) munmap(idx->map, idx->map_size);
+    idx->map = NULL;
+}
+
+
+/* maps the index file; returns false if there is none, or it is damaged */
+static bool map_index(int dirfd, index_t *idx) {
+    struct stat statbuf;
+
+    idx->map = NULL;
+
+    int fd = openat(dirfd, INDEX_NAME, O_RDONLY);
+    if (fd == -1) return false;
+
+    if (fstat(fd, &statbuf) == -1 || (size_t) statbuf.st_size < sizeof(idx_header)) {
+        close(fd);
+        return false;
+    }
+
+    idx->map_size = statbuf.st_size;
+    idx->map = mmap(NULL, idx->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (idx->map == MAP_FAILED) {
+        idx->map = NULL;
+        return false;
+    }
+
+    const idx_header *h = &idx->header;
+    size_t size = idx->map_size;
+
+    memcpy(&idx->header, idx->map, sizeof(idx_header));
+
+    /* bound every count by the size first, so the sums below can't overflow */
+    if (memcmp(h->magic, INDEX_MAGIC, 8) != 0 ||
+        h->num_files > size / sizeof(idx_file) ||
+        h->num_blocks > size / sizeof(idx_block) ||
+        h->num_trigrams > size / sizeof(idx_trigram) ||
+        h->num_postings > size / sizeof(uint32_t) ||
+        h->names_size > size) {
+        unmap_index(idx);
+        return false;
+    }
+
+    size_t off = sizeof(idx_header);
+    const char *base = idx->map;
+
+    idx->files = (const idx_file *) (base + off);
+    off += h->num_files * sizeof(idx_file);
+    idx->blocks = (const idx_block *) (base + off);
+    off += h->num_blocks * sizeof(idx_block);
+    idx->trigrams = (const idx_trigram *) (base + off);
+    off += h->num_trigrams * sizeof(idx_trigram);
+    idx->postings = (const uint32_t *) (base + off);
+    off += (h->num_postings * sizeof(uint32_t) + 7) & ~(size_t) 7;
+    idx->names = base + off;
+    off += h->names_size;
+
+    bool ok = (off == size) && (h->names_size == 0 || idx->names[h->names_size - 1] == '\0');
+
+    for (size_t i = 0; ok && i < h->num_files; i++) {
+        const idx_file *f = &idx->files[i];
+
+        ok = f->name < h->names_size &&
+             f->first_block <= h->num_blocks &&
+             f->num_blocks <= h->num_blocks - f->first_block;
+    }
+
+    for (size_t i = 0; ok && i < h->num_trigrams; i++) {
+        const idx_trigram *t = &idx->trigrams[i];
+
+        ok = t->first <= h->num_postings && t->count <= h->num_postings - t->first;
+    }
+
+    if (!ok) unmap_index(idx);
+
+    return ok;
+}
+
+
+/* returns the old index's entry for the named file, or NULL */
+static const idx_file *find_file(const index_t *idx, const char *name) {
+    size_t lo = 0, hi = idx->header.num_files;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, idx->names + idx->files[mid].name);
+
+        if (cmp == 0) return &idx->files[mid];
+
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void add_file(builder_t *b, const char *name, const struct stat *statbuf,
+                     size_t first_block) {
+    size_t len = strlen(name) + 1;
+
+    b->names = grow(b->names, &b->names_cap, b->names_size, len, 1);
+    memcpy(b->names + b->names_size, name, len);
+
+    b->files = grow(b->files, &b->files_cap, b->num_files, 1, sizeof(idx_file));
+
+    idx_file *f = &b->files[b->num_files++];
+    f->name = b->names_size;
+    f->size = statbuf->st_size;
+    f->mtime_sec = statbuf->st_mtim.tv_sec;
+    f->mtime_nsec = statbuf->st_mtim.tv_nsec;
+    f->first_block = first_block;
+    f->num_blocks = b->num_blocks - first_block;
+
+    b->names_size += len;
+}
+
+
+/* records every distinct trigram found within the lines of the block */
+static void add_trigrams(builder_t *b, const char *p, size_t len, uint32_t block) {
+    size_t first = b->num_pairs;
+    uint32_t t = 0;
+    int have = 0;               /* bytes of t that belong to the current line */
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = p[i];
+
+        if (c == '\n') {
+            /* no match spans lines, so neither do the trigrams */
+            have = 0;
+            continue;
+        }
+
+        t = ((t << 8) | c) & (NUM_TRIGRAMS - 1);
+
+        if (have < 3 && ++have < 3) continue;
+
+        if (b->seen[t >> 3] & (1 << (t & 7))) continue;
+
+        b->seen[t >> 3] |= 1 << (t & 7);
+
+        b->pairs = grow(b->pairs, &b->pairs_cap, b->num_pairs, 1, sizeof(uint64_t));
+        b->pairs[b->num_pairs++] = (uint64_t) t << 32 | block;
+    }
+
+    /* clear only the bits that were set, rather than the whole bitmap */
+    for (size_t i = first; i < b->num_pairs; i++) {
+        t = b->pairs[i] >> 32;
+        b->seen[t >> 3] &= ~(1 << (t & 7));
+    }
+}
+
+
+/* cuts the file into blocks and indexes them */
+static void index_file(builder_t *b, int dirfd, const char *name, const struct stat *statbuf) {
+    size_t first_block = b->num_blocks;
+    size_t size = statbuf->st_size;
+    char *data = NULL;
+
+    if (size > 0) {
+        int fd = openat(dirfd, name, O_RDONLY);
+
+        if (fd == -1) {
+            out_error("wgrep: cannot open file\n");
+        }
+
+        data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (data == MAP_FAILED) {
+            out_error("wgrep: cannot open file\n");
+        }
+
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+
+    size_t off = 0;
+    size_t line = 0;
+
+    while (off < size) {
+        size_t end = size;
+
+        if (size - off > BLOCK_SIZE) {
+            char *nl = memchr(data + off + BLOCK_SIZE, '\n', size - off - BLOCK_SIZE);
+            if (nl != NULL) end = nl - data + 1;
+        }
+
+        b->blocks = grow(b->blocks, &b->blocks_cap, b->num_blocks, 1, sizeof(idx_block));
+        b->blocks[b->num_blocks].off = off;
+        b->blocks[b->num_blocks].line = line;
+
+        add_trigrams(b, data + off, end - off, b->num_blocks);
+        b->num_blocks++;
+
+        line += count_newlines(data + off, end - off);
+        off = end;
+    }
+
+    if (data != NULL) munmap(data, size);
+
+    add_file(b, name, statbuf, first_block);
+}
+
+
+/* sorts the trigrams and writes the new index out under a temporary name */
+static bool write_index(builder_t *b, int dirfd) {
+    if (b->num_pairs > 1) qsort(b->pairs, b->num_pairs, sizeof(uint64_t), compare_pairs);
+
+    idx_trigram *trigrams = malloc(sizeof(idx_trigram) * (b->num_pairs + 1));
+    uint32_t *postings = malloc(sizeof(uint32_t) * (b->num_pairs + 2));
+    size_t num_trigrams = 0;
+
+    if (trigrams == NULL || postings == NULL) {
+        /* malloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    for (size_t i = 0; i < b->num_pairs; i++) {
+        uint32_t t = b->pairs[i] >> 32;
+
+        if (num_trigrams == 0 || trigrams[num_trigrams - 1].trigram != t) {
+            trigrams[num_trigrams].trigram = t;
+            trigrams[num_trigrams].count = 0;
+            trigrams[num_trigrams].first = i;
+            num_trigrams++;
+        }
+
+        trigrams[num_trigrams - 1].count++;
+        postings[i] = (uint32_t) b->pairs[i];
+    }
+
+    idx_header h;
+    memcpy(h.magic, INDEX_MAGIC, 8);
+    h.num_files = b->num_files;
+    h.num_blocks = b->num_blocks;
+    h.num_trigrams = num_trigrams;
+    h.num_postings = b->num_pairs;
+    h.names_size = b->names_size;
+
+    /* keeps the names 8 byte aligned */
+    size_t postings_size = (b->num_pairs * sizeof(uint32_t) + 7) & ~(size_t) 7;
+    memset(postings + b->num_pairs, 0, postings_size - b->num_pairs * sizeof(uint32_t));
+
+    int fd = openat(dirfd, INDEX_TEMP, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    FILE *fp = (fd == -1) ? NULL : fdopen(fd, "w");
+
+    if (fp == NULL) {
+        if (fd != -1) close(fd);
+        free(trigrams);
+        free(postings);
+        return false;
+    }
+
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+              fwrite(b->files, sizeof(idx_file), b->num_files, fp) == b->num_files &&
+              fwrite(b->blocks, sizeof(idx_block), b->num_blocks, fp) == b->num_blocks &&
+              fwrite(trigrams, sizeof(idx_trigram), num_trigrams, fp) == num_trigrams &&
+              fwrite(postings, 1, postings_size, fp) == postings_size &&
+              fwrite(b->names, 1, b->names_size, fp) == b->names_size;
+
+    ok = (fclose(fp) == 0) && ok;
+
+    free(trigrams);
+    free(postings);
+
+    if (!ok) {
+        unlinkat(dirfd, INDEX_TEMP, 0);
+        return false;
+    }
+
+    return renameat(dirfd, INDEX_TEMP, dirfd, INDEX_NAME) == 0;
+}
+
+
+/* brings the index up to date and maps it */
+static void load_index(int dirfd, index_t *idx) {
+    index_t old;
+    bool have_old = map_index(dirfd, &old);
+    builder_t b;
+    size_t num_names;
+    char **names = list_files(dirfd, &num_names);
+
+    memset(&b, 0, sizeof(b));
+
+    /* old block numbers of the unchanged files, mapped to their new ones */
+    uint32_t *remap = NULL;
+    bool changed = !have_old || old.header.num_files != num_names;
+
+    if (have_old) {
+        remap = malloc(sizeof(uint32_t) * (old.header.num_blocks + 1));
+
+        if (remap == NULL) {
+            /* malloc failed */
+            out_error("wgrep: out of memory\n");
+        }
+
+        memset(remap, 0xff, sizeof(uint32_t) * old.header.num_blocks);
+    }
+
+    for (size_t i = 0; i < num_names; i++) {
+        struct stat statbuf;
+
+        if (fstatat(dirfd, names[i], &statbuf, 0) == -1) {
+            out_error("wgrep: cannot open file\n");
+        }
+
+        const idx_file *f = have_old ? find_file(&old, names[i]) : NULL;
+
+        if (f != NULL && f->size == (uint64_t) statbuf.st_size &&
+            f->mtime_sec == statbuf.st_mtim.tv_sec &&
+            f->mtime_nsec == statbuf.st_mtim.tv_nsec) {
+            /* unchanged since it was indexed; carry its blocks over */
+            size_t first_block = b.num_blocks;
+
+            b.blocks = grow(b.blocks, &b.blocks_cap, b.num_blocks, f->num_blocks,
+                            sizeof(idx_block));
+
+            for (size_t k = 0; k < f->num_blocks; k++) {
+                remap[f->first_block + k] = b.num_blocks;
+                b.blocks[b.num_blocks++] = old.blocks[f->first_block + k];
+            }
+
+            add_file(&b, names[i], &statbuf, first_block);
+            continue;
+        }
+
+        if (b.seen == NULL) {
+            b.seen = calloc(NUM_TRIGRAMS / 8, 1);
+
+            if (b.seen == NULL) {
+                /* calloc failed */
+                out_error("wgrep: out of memory\n");
+            }
+        }
+
+        index_file(&b, dirfd, names[i], &statbuf);
+        changed = true;
+    }
+
+    if (changed) {
+        if (have_old) {
+            /* the unchanged files' trigrams come from the old lists */
+            for (size_t i = 0; i < old.header.num_trigrams; i++) {
+                const idx_trigram *t = &old.trigrams[i];
+
+                for (size_t k = 0; k < t->count; k++) {
+                    uint32_t block = old.postings[t->first + k];
+
+                    if (block >= old.header.num_blocks || remap[block] == UINT32_MAX) continue;
+
+                    b.pairs = grow(b.pairs, &b.pairs_cap, b.num_pairs, 1, sizeof(uint64_t));
+                    b.pairs[b.num_pairs++] = (uint64_t) t->trigram << 32 | remap[block];
+                }
+            }
+
+            unmap_index(&old);
+        }
+
+        if (!write_index(&b, dirfd)) {
+            out_error("wgrep: cannot write index\n");
+        }
+
+        have_old = map_index(dirfd, &old);
+    }
+
+    if (!have_old) {
+        /* it was just written; only a damaged disk gets here */
+        out_error("wgrep: cannot read index\n");
+    }
+
+    *idx = old;
+
+    for (size_t i = 0; i < num_names; i++) {
+        free(names[i]);
+    }
+
+    free(names);
+    free(remap);
+    free(b.files);
+    free(b.blocks);
+    free(b.pairs);
+    free(b.names);
+    free(b.seen);
+}
+
+
+static int open_dir(const char *dir) {
+    int dirfd = open(dir, O_RDONLY | O_DIRECTORY);
+
+    if (dirfd == -1) {
+        out_error("wgrep: cannot open directory\n");
+    }
+
+    return dirfd;
+}
+
+
+void update_index(const char *dir) {
+    int dirfd = open_dir(dir);
+    index_t idx;
+
+    load_index(dirfd, &idx);
+
+    unmap_index(&idx);
+    close(dirfd);
+}
+
+
+/**
+ * Finds the blocks that hold every trigram of the matcher's required string,
+ * in increasing order. Returns false if there is no such string, and every
+ * block has to be searched.
+ **/
+static bool find_candidates(const index_t *idx, const matcher_t *matcher,
+                            uint32_t **blocks, size_t *num) {
+    size_t len;
+    const char *req = matcher_required(matcher, &len);
+
+    if (req == NULL || len < 3) return false;
+
+    *blocks = NULL;
+    *num = 0;
+
+    for (size_t i = 0; i + 3 <= len; i++) {
+        uint32_t t = (uint32_t) (unsigned char) req[i] << 16 |
+                     (uint32_t) (unsigned char) req[i + 1] << 8 |
+                     (unsigned char) req[i + 2];
+
+        const idx_trigram *e = bsearch(&t, idx->trigrams, idx->header.num_trigrams,
+                                       sizeof(idx_trigram), compare_trigrams);
+
+        if (e == NULL) {
+            /* no block has it, so nothing can match */
+            free(*blocks);
+            *blocks = NULL;
+            *num = 0;
+            return true;
+        }
+
+        const uint32_t *list = idx->postings + e->first;
+
+        if (i == 0) {
+            *blocks = malloc(sizeof(uint32_t) * (e->count + 1));
+
+            if (*blocks == NULL) {
+                /* malloc failed */
+                out_error("wgrep: out of memory\n");
+            }
+
+            memcpy(*blocks, list, sizeof(uint32_t) * e->count);
+            *num = e->count;
+            continue;
+        }
+
+        /* intersect in place; both lists are sorted */
+        size_t a = 0, k = 0, n = 0;
+
+        while (a < *num && k < e->count) {
+            if ((*blocks)[a] < list[k]) {
+                a++;
+            } else if ((*blocks)[a] > list[k]) {
+                k++;
+            } else {
+                (*blocks)[n++] = (*blocks)[a];
+                a++;
+                k++;
+            }
+        }
+
+        *num = n;
+    }
+
+    return true;
+}
+
+
+int search_index(const char *dir, const matcher_t *matcher, const options_t *opts) {
+    int dirfd = open_dir(dir);
+    index_t idx;
+
+    load_index(dirfd, &idx);
+
+    uint32_t *cand = NULL;
+    size_t num_cand = 0;
+    bool all = !find_candidates(&idx, matcher, &cand, &num_cand);
+    size_t next = 0;            /* next candidate to search */
+
+    match_ctx_t *ctx = new_match_ctx(matcher);
+    hits_t hits;
+
+    if (ctx == NULL) {
+        out_error("wgrep: out of memory\n");
+    }
+
+    init_hits(&hits);
+
+    /* for -l and -q, one match answers the question */
+    size_t max_lines = (opts->list || opts->quiet) ? 1 : opts->max_count;
+
+    for (size_t i = 0; i < idx.header.num_files; i++) {
+        const idx_file *f = &idx.files[i];
+        size_t first = f->first_block;
+        size_t last = first + f->num_blocks;
+        size_t count = 0;
+        char *path = join_path(dir, idx.names + f->name);
+
+        while (next < num_cand && cand[next] < first) next++;
+
+        if (f->num_blocks > 0 && (all || (next < num_cand && cand[next] < last))) {
+            int fd = openat(dirfd, idx.names + f->name, O_RDONLY);
+            char *data = (fd == -1) ? MAP_FAILED
+                                    : mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (fd != -1) close(fd);
+
+            if (data == MAP_FAILED) {
+                out_error("wgrep: cannot open file\n");
+            }
+
+            search_state_t state;
+            out_pos_t pos = { 0, false };
+
+            init_search_state(&state, data, 0, ctx, opts);
+
+            for (size_t k = first; k < last && (count < max_lines || state.pending_after > 0); k++) {
+                bool candidate = all || (next < num_cand && cand[next] == k);
+
+                if (candidate) next++;
+
+                /* a block that can't match may still hold after-context */
+                if (!candidate && state.pending_after == 0) continue;
+
+                size_t start = idx.blocks[k].off;
+                size_t end = (k + 1 < last) ? idx.blocks[k + 1].off : f->size;
+                size_t wanted = (candidate && count < max_lines) ? max_lines - count : 0;
+
+                if (!search_buffer(data, start, end, ctx, opts, &state, &hits, wanted)) {
+                    out_error("wgrep: out of memory\n");
+                }
+
+                count += hits.count;
+
+                if (opts->quiet && count > 0) {
+                    /* found what we were looking for */
+                    exit(EXIT_SUCCESS);
+                }
+
+                if (!opts->count && !opts->list) {
+                    write_hits(data, path, &hits, idx.blocks[k].line + 1, hits.count, opts, &pos);
+                }
+
+                clear_hits(&hits);
+            }
+
+            munmap(data, f->size);
+        }
+
+        write_summary(opts, path, count);
+        free(path);
+    }
+
+    out_flush();
+
+    free_hits(&hits);
+    free_match_ctx(ctx);
+    free(cand);
+    unmap_index(&idx);
+    close(dirfd);
+
+    /* getting this far with -q means nothing matched */
+    return opts->quiet ? EXIT_FAILURE : EXIT_SUCCESS;
+}
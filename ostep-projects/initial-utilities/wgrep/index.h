@@ -0,0 +1,39 @@
+#ifndef INDEX_H_
+#define INDEX_H_
+
+#include <stdbool.h>
+
+#include "match.h"
+#include "options.h"
+
+/**
+ * A trigram index over the files of a directory, kept in the directory
+ * itself as a single file that is mmap()ed rather than parsed.
+ *
+ * Every file is cut into blocks of about 64 KiB that end on a newline, and
+ * the index maps each three byte sequence found within a line to the sorted
+ * list of blocks that hold it. A line containing a string must contain all
+ * of the string's trigrams, so intersecting their lists leaves the only
+ * blocks that can possibly match.
+ *
+ * The index records each file's size and mtime. Updating it re-reads only
+ * the files that are new or have changed since; the lists of the other
+ * files are carried over from the old index.
+ **/
+
+/**
+ * Brings the index of dir up to date. Exits with an error message if the
+ * directory can't be read or the index can't be written.
+ **/
+void update_index(const char *dir);
+
+/**
+ * Updates the index of dir, then searches the files in it for the matcher's
+ * patterns, reading only the blocks the index says may match. Patterns with
+ * no required string of three bytes or more (such as sets of patterns)
+ * still work, but have to read every block. Returns the exit status for the
+ * program.
+ **/
+int search_index(const char *dir, const matcher_t *matcher, const options_t *opts);
+
+#endif // INDEX_H_
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "match.h"
+#include "scan.h"
+
+
+static matcher_t *new_matcher(match_kind kind, bool icase) {
+    matcher_t *m = malloc(sizeof(matcher_t));
+
+    if (m == NULL) {
+        /* malloc failed */
+        return NULL;
+    }
+
+    m->kind = kind;
+    m->literal = NULL;
+    m->literal_len = 0;
+    m->aho = NULL;
+    m->re = NULL;
+    m->icase = icase;
+
+    return m;
+}
+
+
+matcher_t *matcher_literal(const char *query, bool icase) {
+    matcher_t *m = new_matcher(MATCH_LITERAL, icase);
+
+    if (m == NULL) return NULL;
+
+    m->literal = strdup(query);
+
+    if (m->literal == NULL) {
+        /* strdup failed */
+        free(m);
+        return NULL;
+    }
+
+    m->literal_len = strlen(query);
+
+    return m;
+}
+
+
+matcher_t *matcher_from_file(const char *filename, bool icase) {
+    FILE *fp = fopen(filename, "r");
+
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    char **patterns = NULL;
+    size_t *lengths = NULL;
+    size_t num = 0;
+
+    char *lineptr = NULL;
+    size_t n = 0;
+    ssize_t len;
+    matcher_t *m = NULL;
+
+    while ((len = getline(&lineptr, &n, fp)) != -1) {
+        if (len > 0 && lineptr[len - 1] == '\n') {
+            /* the newline only separates patterns */
+            lineptr[--len] = '\0';
+        }
+
+        char **p_tmp = realloc(patterns, sizeof(char *) * (num + 1));
+        if (p_tmp == NULL) goto cleanup;
+        patterns = p_tmp;
+
+        size_t *l_tmp = realloc(lengths, sizeof(size_t) * (num + 1));
+        if (l_tmp == NULL) goto cleanup;
+        lengths = l_tmp;
+
+        /* the pattern may hold NUL bytes, so copy by length */
+        patterns[num] = malloc(len + 1);
+        if (patterns[num] == NULL) goto cleanup;
+
+        memcpy(patterns[num], lineptr, len + 1);
+        lengths[num] = len;
+        num++;
+    }
+
+    if (num == 1) {
+        /* a lone pattern is better served by the literal scanner */
+        m = new_matcher(MATCH_LITERAL, icase);
+        if (m == NULL) goto cleanup;
+
+        m->literal = patterns[0];
+        m->literal_len = lengths[0];
+        patterns[0] = NULL;
+    } else {
+        m = new_matcher(MATCH_MULTI, icase);
+        if (m == NULL) goto cleanup;
+
+        m->aho = aho_build(patterns, lengths, num, icase);
+
+        if (m->aho == NULL) {
+            /* couldn't build the automaton */
+            free(m);
+            m = NULL;
+        }
+    }
+
+cleanup:
+    for (size_t i = 0; i < num; i++) {
+        free(patterns[i]);
+    }
+
+    free(patterns);
+    free(lengths);
+    free(lineptr);
+    fclose(fp);
+
+    return m;
+}
+
+
+matcher_t *matcher_regex(const char *pattern, bool icase) {
+    re_prog_t *re = re_compile(pattern, icase);
+
+    if (re == NULL) {
+        /* invalid pattern */
+        return NULL;
+    }
+
+    size_t len;
+    const char *literal = re_literal(re, &len);
+    matcher_t *m;
+
+    if (literal != NULL) {
+        /* nothing special in the pattern; the literal scanner will do */
+        m = new_matcher(MATCH_LITERAL, icase);
+
+        if (m != NULL) {
+            m->literal = malloc(len + 1);
+
+            if (m->literal == NULL) {
+                /* malloc failed */
+                free(m);
+                m = NULL;
+            } else {
+                memcpy(m->literal, literal, len);
+                m->literal[len] = '\0';
+                m->literal_len = len;
+            }
+        }
+
+        re_free(re);
+        return m;
+    }
+
+    m = new_matcher(MATCH_REGEX, icase);
+
+    if (m == NULL) {
+        re_free(re);
+        return NULL;
+    }
+
+    m->re = re;
+    return m;
+}
+
+
+void free_matcher(matcher_t *m) {
+    if (m == NULL) return;
+
+    free(m->literal);
+    aho_free(m->aho);
+    re_free(m->re);
+    free(m);
+}
+
+
+const char *matcher_required(const matcher_t *m, size_t *len) {
+    if (m->icase) return NULL;
+
+    switch (m->kind) {
+        case MATCH_LITERAL:
+            *len = m->literal_len;
+            return m->literal;
+
+        case MATCH_REGEX:
+            return re_prefix(m->re, len);
+
+        default:
+            return NULL;
+    }
+}
+
+
+match_ctx_t *new_match_ctx(const matcher_t *m) {
+    match_ctx_t *ctx = malloc(sizeof(match_ctx_t));
+
+    if (ctx == NULL) {
+        /* malloc failed */
+        return NULL;
+    }
+
+    ctx->matcher = m;
+    ctx->dfa = NULL;
+
+    if (m->kind == MATCH_REGEX) {
+        ctx->dfa = re_dfa_new(m->re);
+
+        if (ctx->dfa == NULL) {
+            free(ctx);
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+
+void free_match_ctx(match_ctx_t *ctx) {
+    if (ctx == NULL) return;
+
+    re_dfa_free(ctx->dfa);
+    free(ctx);
+}
+
+
+const char *find_match(match_ctx_t *ctx, const char *start, const char *end) {
+    const matcher_t *m = ctx->matcher;
+
+    switch (m->kind) {
+        case MATCH_LITERAL:
+            if (m->icase) {
+                return scan_literal_icase(start, end - start, m->literal, m->literal_len);
+            }
+
+            return scan_literal(start, end - start, m->literal, m->literal_len);
+
+        case MATCH_MULTI:
+            return aho_find(m->aho, start, end);
+
+        case MATCH_REGEX:
+            return re_find(ctx->dfa, start, end);
+    }
+
+    /* we should never reach here */
+    return NULL;
+}
@@ -0,0 +1,84 @@
+#ifndef MATCH_H_
+#define MATCH_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "aho.h"
+#include "re.h"
+
+/**
+ * Enum defines the different ways a line can be matched
+ **/
+typedef enum {
+    MATCH_LITERAL,              /* a single search string */
+    MATCH_MULTI,                /* any of a set of strings (Aho-Corasick) */
+    MATCH_REGEX                 /* a regular expression (lazy DFA) */
+} match_kind;
+
+/**
+ * Struct describes what the search is looking for. Matchers are read-only
+ * once built, so all the worker threads share a single one.
+ **/
+typedef struct {
+    match_kind kind;            /* which of the fields below is in use */
+    char       *literal;        /* the search string for MATCH_LITERAL */
+    size_t     literal_len;     /* its length */
+    aho_t      *aho;            /* the automaton for MATCH_MULTI */
+    re_prog_t  *re;             /* the compiled pattern for MATCH_REGEX */
+    bool       icase;           /* ASCII letters match either case */
+} matcher_t;
+
+/**
+ * Struct holds a thread's own state for running a matcher: the regular
+ * expression engine builds its DFA as it goes, so each thread needs its own.
+ **/
+typedef struct {
+    const matcher_t *matcher;   /* the shared matcher */
+    re_dfa_t        *dfa;       /* DFA cache for MATCH_REGEX */
+} match_ctx_t;
+
+
+/**
+ * The constructors below take an icase flag; when it is set, ASCII letters
+ * in the patterns match either case.
+ **/
+
+/* builds a matcher for a single search string */
+matcher_t *matcher_literal(const char*, bool icase);
+
+/**
+ * Builds a matcher for the patterns in the given file, one per line. Returns
+ * NULL if the file can't be read.
+ **/
+matcher_t *matcher_from_file(const char*, bool icase);
+
+/**
+ * Builds a matcher for an extended regular expression. Returns NULL if the
+ * pattern is invalid.
+ **/
+matcher_t *matcher_regex(const char*, bool icase);
+
+void free_matcher(matcher_t*);
+
+/**
+ * Returns a string every matching line must contain (and its length in len),
+ * or NULL if the matcher has none, as for a set of patterns. Case-insensitive
+ * matchers have none either, as the string's case isn't known.
+ **/
+const char *matcher_required(const matcher_t*, size_t *len);
+
+/* sets up a context for using the matcher from one thread */
+match_ctx_t *new_match_ctx(const matcher_t*);
+
+void free_match_ctx(match_ctx_t*);
+
+/**
+ * Returns a pointer into the first matching line found in [start, end), or
+ * NULL if there is none. start must be at the beginning of a line. The
+ * pointer may land anywhere within the match, which is all the
+ * line-oriented search needs.
+ **/
+const char *find_match(match_ctx_t*, const char *start, const char *end);
+
+#endif // MATCH_H_
@@ -0,0 +1,28 @@
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Struct holds the command line options that change what gets written out,
+ * and how much of the input has to be read to write it.
+ **/
+typedef struct {
+    bool   count;               /* -c: print the number of matching lines */
+    bool   list;                /* -l: print the names of files that match */
+    bool   quiet;               /* -q: print nothing; exit 0 on the first match */
+    size_t max_count;           /* -m: stop a file after this many matches */
+    bool   with_names;          /* prefix counts (and -l) with file names */
+    bool   name_lines;          /* -r, --index: prefix printed lines with file names */
+    bool   line_numbers;        /* -n: prefix lines with their line number */
+    size_t before;              /* -B: context lines to print before a match */
+    size_t after;               /* -A: context lines to print after a match */
+    bool   context;             /* -A, -B or -C given, even as 0: groups get "--" */
+    bool   recursive;           /* -r: search directories, skipping binary files */
+} options_t;
+
+/* name printed for standard input */
+#define STDIN_NAME "(standard input)"
+
+#endif // OPTIONS_H_
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "output.h"
+
+#define OUT_SIZE (256 << 10)    /* size of the output buffer */
+
+static char   out_buf[OUT_SIZE];
+static size_t out_len = 0;
+
+static bool   groups_written = false;   /* any lines written at all, for "--" */
+
+
+/* write() the whole of buf, retrying short writes */
+static void write_all(const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+
+            /* stdout is gone (e.g. the reader of a pipe quit); stop quietly */
+            exit(EXIT_FAILURE);
+        }
+
+        buf += n;
+        len -= n;
+    }
+}
+
+
+void out_flush() {
+    write_all(out_buf, out_len);
+    out_len = 0;
+}
+
+
+void out_write(const char *buf, size_t len) {
+    if (out_len + len <= OUT_SIZE) {
+        memcpy(out_buf + out_len, buf, len);
+        out_len += len;
+        return;
+    }
+
+    out_flush();
+
+    if (len >= OUT_SIZE) {
+        /* no point copying something this big; write it straight out */
+        write_all(buf, len);
+        return;
+    }
+
+    memcpy(out_buf, buf, len);
+    out_len = len;
+}
+
+
+void out_error(const char *msg) {
+    out_write(msg, strlen(msg));
+    out_flush();
+    exit(EXIT_FAILURE);
+}
+
+
+/**
+ * Writes the lines of data[off, off + len), each prefixed with the file's
+ * name (unless name is NULL) and with its number (unless lineno is 0), each
+ * followed by sep, as grep does.
+ **/
+static void write_prefixed(const char *data, size_t off, size_t len, const char *name,
+                           long lineno, char sep) {
+    const char *p = data + off;
+    const char *end = p + len;
+    size_t name_len = (name != NULL) ? strlen(name) : 0;
+    char buf[32];
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *line_end = (nl == NULL) ? end : nl + 1;
+
+        if (name != NULL) {
+            out_write(name, name_len);
+            out_write(&sep, 1);
+        }
+
+        if (lineno > 0) {
+            int n = snprintf(buf, sizeof(buf), "%ld%c", lineno++, sep);
+            out_write(buf, n);
+        }
+
+        out_write(p, line_end - p);
+
+        p = line_end;
+    }
+}
+
+
+void write_hits(const char *data, const char *name, const hits_t *hits, long first_line,
+                size_t max_lines, const options_t *opts, out_pos_t *pos) {
+    for (size_t i = 0; i < hits->num; i++) {
+        const line_t *line = &hits->lines[i];
+        size_t off = line->off;
+        size_t len = line->len;
+        size_t lines = line->lines;
+        long lineno = first_line + line->lineno;
+
+        if (!line->context && max_lines == 0) break;
+
+        if (pos->valid && off < pos->end) {
+            /* some of these lines were already written by an earlier chunk */
+            if (off + len <= pos->end) continue;
+
+            while (off < pos->end) {
+                const char *nl = memchr(data + off, '\n', pos->end - off);
+                size_t skip = nl - (data + off) + 1;
+
+                off += skip;
+                len -= skip;
+                lines--;
+                lineno++;
+            }
+        }
+
+        if (!line->context && lines > max_lines) {
+            /* only part of this run of lines is wanted */
+            const char *p = data + off;
+
+            for (size_t n = 0; n < max_lines; n++) {
+                p = memchr(p, '\n', data + off + len - p) + 1;
+            }
+
+            len = p - (data + off);
+            lines = max_lines;
+        }
+
+        if (!line->context) max_lines -= lines;
+
+        if (opts->context && groups_written && !(pos->valid && off == pos->end)) {
+            /* this group doesn't follow on from the last one */
+            out_write("--\n", 3);
+        }
+
+        if (opts->line_numbers || opts->name_lines) {
+            write_prefixed(data, off, len, opts->name_lines ? name : NULL,
+                           opts->line_numbers ? lineno : 0, line->context ? '-' : ':');
+        } else {
+            out_write(data + off, len);
+        }
+
+        groups_written = true;
+        pos->end = off + len;
+        pos->valid = true;
+    }
+}
+
+
+void write_summary(const options_t *opts, const char *name, size_t count) {
+    char buf[32];
+
+    if (opts->quiet) return;
+
+    if (opts->count) {
+        if (opts->with_names) {
+            out_write(name, strlen(name));
+            out_write(":", 1);
+        }
+
+        int len = snprintf(buf, sizeof(buf), "%zu\n", count);
+        out_write(buf, len);
+    } else if (opts->list && count > 0) {
+        out_write(name, strlen(name));
+        out_write("\n", 1);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "options.h"
+#include "search.h"
+
+/**
+ * Everything wgrep prints goes through one large buffer that is handed to
+ * write() when it fills up, instead of a printf() for every line. Only one
+ * thread (the sequencer, or the stdin reader) may write at a time.
+ **/
+
+void out_write(const char*, size_t);
+
+void out_flush();
+
+/* writes the message after whatever is already buffered, then exits */
+void out_error(const char*);
+
+/**
+ * Remembers where the last line written out of some data ended. Neighbouring
+ * chunks of a file may both find the same context lines; anything before the
+ * end is not written again, and with context a "--" line goes between groups
+ * of lines that don't follow each other.
+ **/
+typedef struct {
+    size_t end;                 /* offset just past the last line written */
+    bool   valid;               /* end refers to the data being written */
+} out_pos_t;
+
+/**
+ * Writes out the lines in hits, stopping after max_lines matching lines (the
+ * context after the last one is still written). The offsets in hits are
+ * relative to data, and first_line is the number of the line at the start of
+ * the search, for -n. With names on, each line starts with the file's name.
+ **/
+void write_hits(const char *data, const char *name, const hits_t*, long first_line,
+                size_t max_lines, const options_t*, out_pos_t*);
+
+/**
+ * Writes the per-file line for -c (the count) or -l (the name, if anything
+ * matched). Does nothing when neither is set.
+ **/
+void write_summary(const options_t*, const char *name, size_t count);
+
+#endif // OUTPUT_H_
@@ -0,0 +1,572 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "pool.h"
+#include "search.h"
+#include "output.h"
+#include "walk.h"
+
+#ifndef CHUNK_SIZE
+#define CHUNK_SIZE (4 << 20)    /* files larger than this get split up */
+#endif
+
+#define JOBS_PER_THREAD 4       /* jobs allowed in flight for every worker */
+#define READ_SIZE (64 << 10)    /* read size for files that can't be mapped */
+#define PROBE_SIZE (32 << 10)   /* bytes checked for a NUL to spot binary files */
+
+#define handle_error_en(en, msg)                \
+    do { errno = en; perror(msg); exit(EXIT_FAILURE); } while(0)
+
+
+/* a file being searched, shared by all the jobs cut from it */
+typedef struct {
+    const char *name;           /* the file's name, as given or found */
+    bool       own_name;        /* name was allocated by the walk */
+    char       *data;           /* the file's contents */
+    size_t     size;            /* size of the contents in bytes */
+    bool       mapped;          /* contents were mmap()ed instead of read in */
+    int        fd;              /* still to be read in by its worker, or -1 */
+    int        refs;            /* jobs (plus the producer) still using it */
+    size_t     count;           /* matching lines written out so far */
+    size_t     lines;           /* lines in the jobs written out so far, for -n */
+    out_pos_t  pos;             /* where the last line written out ended */
+    bool       done;            /* the rest of the file is not needed */
+    bool       binary;          /* skipped as binary; nothing is written for it */
+} file_ref;
+
+/* states a job slot goes through */
+typedef enum {
+    JOB_RUNNING,                /* a worker is searching it */
+    JOB_DONE,                   /* results are ready for the sequencer */
+    JOB_FAILED                  /* nothing to search; print the error and stop */
+} job_state;
+
+/* a single unit of work: one file, or one chunk of a larger file */
+typedef struct {
+    job_state  state;           /* where the job is at */
+    file_ref   *file;           /* the file the job's range belongs to */
+    size_t     start, end;      /* range of the file to search */
+    bool       last;            /* this is the file's final job */
+    hits_t     hits;            /* lines found in the range */
+    const char *error;          /* message to print when the job failed */
+} job_t;
+
+/* state shared between the workers and the sequencer */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  ready;      /* signalled when a job finishes */
+    pthread_cond_t  space;      /* signalled when a job slot frees up, or a
+                                   file has been opened */
+
+    char       **files;         /* files to search, in output order */
+    size_t     num_files;       /* number of files */
+    size_t     next_file;       /* next file to open */
+    walk_t     *walk;           /* with -r, where the files come from instead */
+    file_ref   *current;        /* file being cut into jobs */
+    bool       opening;         /* a worker is opening the next file */
+    size_t     offset;          /* where the next job starts in current */
+    bool       finished;        /* no more jobs will be produced */
+
+    const matcher_t *matcher;   /* what to search for */
+    const options_t *opts;      /* what to write out */
+    size_t     max_lines;       /* most matching lines a job has to find */
+    bool       split;           /* large files may be cut into chunks */
+
+    job_t      *slots;          /* ring of in-flight jobs */
+    size_t     num_slots;       /* size of the ring */
+    size_t     produced;        /* jobs handed out so far */
+    size_t     written;         /* jobs written out so far */
+} pool_t;
+
+
+static file_ref *open_file(const char *, bool);
+
+static void close_file(file_ref *);
+
+static job_t *next_job(pool_t *);
+
+static bool release_file(file_ref *);
+
+static bool load_file(file_ref *);
+
+static void *search_worker(void *);
+
+
+int search_files(char **files, size_t num_files, const matcher_t *matcher,
+                 const options_t *opts) {
+    pool_t pool;
+    int nthreads = get_nprocs();
+    int err;
+
+    if (nthreads < 1) nthreads = 1;
+
+    pool.files = files;
+    pool.num_files = num_files;
+    pool.next_file = 0;
+    pool.walk = opts->recursive ? walk_start(files, num_files) : NULL;
+    pool.current = NULL;
+    pool.opening = false;
+    pool.offset = 0;
+    pool.finished = false;
+    pool.matcher = matcher;
+    pool.opts = opts;
+
+    /* for -l and -q, one match answers the question */
+    pool.max_lines = (opts->list || opts->quiet) ? 1 : opts->max_count;
+
+    /**
+     * Chunks find their own context across their edges, but with -m a later
+     * chunk can't know which of its context lines belong to matches past the
+     * limit; such files are searched whole instead.
+     **/
+    pool.split = !((opts->before > 0 || opts->after > 0) && opts->max_count != SIZE_MAX);
+    pool.num_slots = nthreads * JOBS_PER_THREAD;
+    pool.produced = 0;
+    pool.written = 0;
+
+    pool.slots = calloc(pool.num_slots, sizeof(job_t));
+    pthread_t *workers = calloc(nthreads, sizeof(pthread_t));
+
+    if (pool.slots == NULL || workers == NULL) {
+        /* calloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    for (size_t i = 0; i < pool.num_slots; i++) {
+        init_hits(&pool.slots[i].hits);
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pthread_cond_init(&pool.space, NULL);
+
+    for (int t = 0; t < nthreads; t++) {
+        err = pthread_create(&workers[t], NULL, &search_worker, &pool);
+        if (err != 0) {
+            handle_error_en(err, "pthread_create");
+        }
+    }
+
+    /* act as the sequencer: write jobs out strictly in the order produced */
+    pthread_mutex_lock(&pool.lock);
+
+    while (true) {
+        job_t *job = &pool.slots[pool.written % pool.num_slots];
+
+        while ((pool.written == pool.produced && !pool.finished) ||
+               (pool.written < pool.produced && job->state == JOB_RUNNING)) {
+            pthread_cond_wait(&pool.ready, &pool.lock);
+        }
+
+        if (pool.written == pool.produced) {
+            /* finished, and everything has been written */
+            break;
+        }
+
+        pthread_mutex_unlock(&pool.lock);
+
+        if (job->state == JOB_FAILED) {
+            /* everything before the failure is out; report it and stop */
+            out_error(job->error);
+        }
+
+        file_ref *file = job->file;
+        bool done = file->done;
+
+        if (!done) {
+            /* earlier chunks may have used up some of the -m allowance */
+            size_t wanted = opts->max_count - file->count;
+            size_t found = (job->hits.count < wanted) ? job->hits.count : wanted;
+
+            if (!opts->count && !opts->list && !opts->quiet) {
+                write_hits(file->data, file->name, &job->hits, file->lines + 1, wanted, opts, &file->pos);
+            }
+
+            file->count += found;
+            file->lines += job->hits.newlines;
+
+            /* once the answer for the file is known, skip the rest of it */
+            done = (file->count == opts->max_count) || (opts->list && file->count > 0);
+        }
+
+        if (job->last && !file->binary) {
+            write_summary(opts, file->name, file->count);
+        }
+
+        clear_hits(&job->hits); /* keep the allocation for the next job */
+
+        pthread_mutex_lock(&pool.lock);
+
+        file->done = done;
+
+        if (release_file(file)) {
+            close_file(file);
+        }
+
+        pool.written++;
+        pthread_cond_broadcast(&pool.space);
+    }
+
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int t = 0; t < nthreads; t++) {
+        err = pthread_join(workers[t], NULL);
+        if (err != 0) {
+            handle_error_en(err, "pthread_join");
+        }
+    }
+
+    for (size_t i = 0; i < pool.num_slots; i++) {
+        free_hits(&pool.slots[i].hits);
+    }
+
+    if (pool.walk != NULL) walk_free(pool.walk);
+
+    free(pool.slots);
+    free(workers);
+
+    pthread_cond_destroy(&pool.space);
+    pthread_cond_destroy(&pool.ready);
+    pthread_mutex_destroy(&pool.lock);
+
+    out_flush();
+
+    /* getting this far with -q means nothing matched */
+    return opts->quiet ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+static void *search_worker(void *arg) {
+    pool_t *pool = arg;
+    match_ctx_t *ctx = new_match_ctx(pool->matcher);
+    search_state_t state;
+
+    if (ctx == NULL) {
+        /* couldn't set up the matcher for this thread */
+        out_error("wgrep: out of memory\n");
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true) {
+        /* don't run too far ahead of the sequencer, and let the worker
+         * opening the next file hand out its first job */
+        while (!pool->finished &&
+               (pool->produced - pool->written >= pool->num_slots || pool->opening)) {
+            pthread_cond_wait(&pool->space, &pool->lock);
+        }
+
+        job_t *job = next_job(pool);
+
+        if (job == NULL) {
+            /* nothing left to hand out */
+            break;
+        }
+
+        if (job->state == JOB_FAILED || job->file->done) {
+            /* nothing to search for this job */
+            if (job->state != JOB_FAILED) job->state = JOB_DONE;
+            pthread_cond_broadcast(&pool->ready);
+            continue;
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+
+        file_ref *file = job->file;
+
+        if (file->fd != -1) {
+            /* small files are read here, outside the lock */
+            if (!load_file(file)) {
+                pthread_mutex_lock(&pool->lock);
+                job->state = JOB_FAILED;
+                job->error = "wgrep: cannot open file\n";
+                pthread_cond_broadcast(&pool->ready);
+                continue;
+            }
+
+            job->end = file->size;
+        }
+
+        bool ok = true;
+
+        if (!file->binary) {
+            init_search_state(&state, file->data, job->start, ctx, pool->opts);
+
+            ok = search_buffer(file->data, job->start, job->end, ctx,
+                               pool->opts, &state, &job->hits, pool->max_lines);
+        }
+
+        if (pool->opts->quiet && job->hits.count > 0) {
+            /* the answer is yes, whatever the other jobs find */
+            exit(EXIT_SUCCESS);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+
+        if (ok) {
+            job->state = JOB_DONE;
+        } else {
+            job->state = JOB_FAILED;
+            job->error = "wgrep: out of memory\n";
+        }
+
+        pthread_cond_broadcast(&pool->ready);
+    }
+
+    /* the sequencer may be waiting on the last job that will ever come */
+    pthread_cond_broadcast(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    free_match_ctx(ctx);
+    return NULL;
+}
+
+
+/**
+ * Hands out the next job; must be called with the pool lock held. Getting
+ * the next file's name (which may wait for the walk) and opening it happen
+ * with the lock released, while the other workers wait for the file.
+ **/
+static job_t *next_job(pool_t *pool) {
+    if (pool->finished) return NULL;
+
+    while (pool->current == NULL) {
+        char *name;
+        file_ref *file = NULL;
+
+        pool->opening = true;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (pool->walk != NULL) {
+            /* may wait for the walkers to read the file's directory */
+            name = walk_next(pool->walk);
+        } else {
+            name = (pool->next_file < pool->num_files) ? pool->files[pool->next_file++] : NULL;
+        }
+
+        if (name != NULL) file = open_file(name, pool->walk != NULL);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->opening = false;
+        pthread_cond_broadcast(&pool->space);
+
+        if (name == NULL) {
+            /* all files have been handed out */
+            pool->finished = true;
+            return NULL;
+        }
+
+        if (file == NULL) {
+            /* queue the error behind the jobs before it, and stop producing */
+            job_t *job = &pool->slots[pool->produced++ % pool->num_slots];
+            job->state = JOB_FAILED;
+            job->error = "wgrep: cannot open file\n";
+            job->file = NULL;
+            pool->finished = true;
+            return job;
+        }
+
+        pool->current = file;
+        pool->offset = 0;
+    }
+
+    file_ref *file = pool->current;
+    size_t start = pool->offset;
+    size_t end = file->size;
+
+    if (file->done) {
+        /* the sequencer has all it needs; close the file with an empty job */
+        end = start;
+    } else if (pool->split && file->size - start > CHUNK_SIZE) {
+        /* cut the chunk after the first newline past the chunk size */
+        char *nl = memchr(file->data + start + CHUNK_SIZE, '\n',
+                          file->size - start - CHUNK_SIZE);
+        if (nl != NULL) end = nl - file->data + 1;
+    }
+
+    job_t *job = &pool->slots[pool->produced++ % pool->num_slots];
+    job->state = JOB_RUNNING;
+    job->file = file;
+    job->start = start;
+    job->end = end;
+    job->error = NULL;
+    job->last = (end == file->size || file->done);
+
+    file->refs++;
+    pool->offset = end;
+
+    if (job->last) {
+        /* the whole file has been handed out; drop the producer's reference */
+        release_file(file);
+        pool->current = NULL;
+    }
+
+    return job;
+}
+
+
+/* drops a reference to the file; returns true if it was the last one */
+static bool release_file(file_ref *file) {
+    return --file->refs == 0;
+}
+
+
+/* reads everything left in fd into the file's buffer */
+static bool read_whole(int fd, file_ref *file, size_t cap) {
+    ssize_t n;
+
+    do {
+        if (file->size == cap) {
+            cap = (cap < READ_SIZE) ? READ_SIZE : cap * 2;
+
+            char *tmp = realloc(file->data, cap);
+
+            if (tmp == NULL) {
+                /* realloc failed */
+                return false;
+            }
+
+            file->data = tmp;
+        }
+
+        n = read(fd, file->data + file->size, cap - file->size);
+        if (n > 0) file->size += n;
+    } while (n > 0 || (n == -1 && errno == EINTR));
+
+    return n == 0;
+}
+
+
+/* skips files found by the walk that have a NUL near the start */
+static void probe_binary(file_ref *file) {
+    size_t len = (file->size < PROBE_SIZE) ? file->size : PROBE_SIZE;
+
+    if (file->own_name && len > 0 && memchr(file->data, '\0', len) != NULL) {
+        /* not text; the sequencer closes it with a single empty job */
+        file->binary = true;
+        file->done = true;
+    }
+}
+
+
+/**
+ * Opens the file. Files too small to be split are left for the worker that
+ * searches them to read in, so the worker opening files (which the others
+ * wait on) only opens them; larger files are mapped here. Files found by the
+ * walk take ownership of their name.
+ **/
+static file_ref *open_file(const char *name, bool walked) {
+    struct stat statbuf;
+
+    int fd = open(name, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    if (fstat(fd, &statbuf) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    file_ref *file = malloc(sizeof(file_ref));
+    if (file == NULL) {
+        /* malloc failed */
+        close(fd);
+        return NULL;
+    }
+
+    file->name = name;
+    file->own_name = walked;
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = false;
+    file->fd = -1;
+    file->refs = 1;             /* the producer's own reference */
+    file->count = 0;
+    file->lines = 0;
+    file->pos.valid = false;
+    file->done = false;
+    file->binary = false;
+
+    if (S_ISREG(statbuf.st_mode) && statbuf.st_size > 0 && statbuf.st_size <= CHUNK_SIZE) {
+        /* a single job; its worker reads it in */
+        file->fd = fd;
+        file->size = statbuf.st_size;
+        return file;
+    }
+
+    if (S_ISREG(statbuf.st_mode) && statbuf.st_size > 0) {
+        file->data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (file->data != MAP_FAILED) {
+            file->size = statbuf.st_size;
+            file->mapped = true;
+            madvise(file->data, file->size, MADV_SEQUENTIAL);
+        } else {
+            file->data = NULL;
+        }
+    }
+
+    if (!file->mapped && !S_ISDIR(statbuf.st_mode)) {
+        /* pipes and the like can't be mapped; read them in whole */
+        if (!read_whole(fd, file, 0)) {
+            free(file->data);
+            free(file);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    close(fd);
+    probe_binary(file);
+
+    return file;
+}
+
+
+/* reads in a file left to the worker by open_file(); runs without the lock */
+static bool load_file(file_ref *file) {
+    size_t cap = file->size + 1;    /* room to notice it has grown */
+    bool ok;
+
+    file->size = 0;
+    file->data = malloc(cap);
+
+    ok = (file->data != NULL) && read_whole(file->fd, file, cap);
+
+    close(file->fd);
+    file->fd = -1;
+
+    if (ok) probe_binary(file);
+
+    return ok;
+}
+
+
+static void close_file(file_ref *file) {
+    if (file->fd != -1) {
+        /* its job was skipped before the file was read */
+        close(file->fd);
+    }
+
+    if (file->mapped) {
+        munmap(file->data, file->size);
+    } else {
+        free(file->data);
+    }
+
+    if (file->own_name) free((char *) file->name);
+
+    free(file);
+}
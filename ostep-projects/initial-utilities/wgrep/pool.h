@@ -0,0 +1,33 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stddef.h>
+
+#include "match.h"
+#include "options.h"
+
+/**
+ * Searches the given files for the matcher's patterns with a pool of worker
+ * threads.
+ *
+ * Small files are handed out whole while large ones are cut into chunks that
+ * end on a newline, so several workers can share one file. Each file or chunk
+ * becomes a numbered job, and the calling thread acts as the sequencer: it
+ * writes out the results of job n only after those of job n - 1, so the
+ * output is exactly what a serial search would produce.
+ *
+ * Once the answer for a file is known (its -m limit is reached, or with -l
+ * its first match is found), the jobs still to come for it are skipped. With
+ * -q the first match found anywhere ends the program.
+ *
+ * With -r, the files are taken from a walk of the given directory trees
+ * (see walk.h) that runs alongside the search, and files that look binary
+ * are skipped without a word.
+ *
+ * A file that cannot be opened stops the search at that point, the same way
+ * the serial version did. Returns the exit status for the program.
+ **/
+int search_files(char **files, size_t num_files, const matcher_t *matcher,
+                 const options_t *opts);
+
+#endif // POOL_H_
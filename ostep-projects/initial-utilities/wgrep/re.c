@@ -0,0 +1,1108 @@
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "re.h"
+#include "scan.h"
+
+#define MAX_PROG 100000         /* largest program a pattern may compile to */
+#define MAX_REPEAT 1000         /* largest bound allowed in {n,m} */
+#define DFA_CACHE_SIZE (2 << 20) /* bytes of transitions cached per thread */
+#define MIN_STATES 64           /* the cache always holds at least this many */
+
+#define UNKNOWN -1              /* transition not computed yet */
+#define MATCHED -2              /* transition completes a match */
+
+/* pseudo instruction marking the state at the start of a line */
+#define LINE_START(p) ((p)->num_insts)
+
+
+/* node types of the parsed pattern */
+typedef enum {
+    N_EMPTY,                    /* matches the empty string */
+    N_SET,                      /* one byte out of a set */
+    N_CAT,                      /* left followed by right */
+    N_ALT,                      /* left or right */
+    N_STAR,                     /* zero or more of left */
+    N_PLUS,                     /* one or more of left */
+    N_QUEST,                    /* zero or one of left */
+    N_REPEAT,                   /* min to max of left (max -1: unbounded) */
+    N_BOL,                      /* start of line */
+    N_EOL                       /* end of line */
+} node_type;
+
+typedef struct {
+    node_type typ;
+    int left, right;            /* child nodes */
+    int min, max;               /* bounds for N_REPEAT */
+    int set;                    /* set index for N_SET */
+} node_t;
+
+/* a set of bytes, one bit per byte value */
+typedef struct {
+    uint64_t bits[4];
+} byteset_t;
+
+/* NFA instructions */
+typedef enum {
+    OP_SET,                     /* consume a byte in sets[x] */
+    OP_SPLIT,                   /* continue at both x and y */
+    OP_JMP,                     /* continue at x */
+    OP_BOL,                     /* only passable at the start of a line */
+    OP_EOL,                     /* only passable at the end of a line */
+    OP_MATCH                    /* the pattern matched */
+} op_type;
+
+typedef struct {
+    op_type op;
+    int x, y;
+} inst_t;
+
+struct re_prog {
+    inst_t    *insts;           /* the NFA program; starts at 0 */
+    int       num_insts;
+    byteset_t *sets;            /* byte sets used by OP_SET */
+    int       num_sets;
+    uint8_t   classes[256];     /* byte to equivalence class */
+    uint8_t   reps[256];        /* a representative byte for every class */
+    int       num_classes;
+    char      *prefix;          /* literal every match starts with */
+    size_t    prefix_len;
+    bool      literal;          /* the pattern is nothing but the prefix */
+    bool      every_line;       /* the pattern matches at every line start */
+};
+
+/* a DFA state: the set of NFA instructions the scan could be at */
+typedef struct {
+    size_t   off;               /* offset of the sorted pc list in pcs */
+    int      len;               /* length of the pc list */
+    uint32_t hash;              /* hash of the pc list */
+    bool     accept;            /* holds OP_MATCH */
+    bool     accept_eol;        /* matches if the line ends here */
+} dstate_t;
+
+struct re_dfa {
+    const re_prog_t *prog;
+
+    int32_t  *trans;            /* num_classes transitions per state */
+    dstate_t *states;
+    int      num_states;
+    int      max_states;        /* cache capacity */
+    int      line_start;        /* state at the start of a line, or -1 */
+    uint32_t flushes;           /* times the cache was emptied */
+
+    int      *pcs;              /* arena holding every state's pc list */
+    size_t   num_pcs, cap_pcs;
+
+    int      *table;            /* open-addressed hash of states */
+    size_t   table_size;
+
+    /* scratch space for building states */
+    uint32_t *mark;             /* generation an instruction was last seen in */
+    uint32_t gen;
+    int      *stack;
+    int      *list;
+    int      num_list;
+};
+
+/* parser state */
+typedef struct {
+    const char *pos;            /* next character of the pattern */
+    node_t     *nodes;
+    int        num_nodes, cap_nodes;
+    byteset_t  *sets;
+    int        num_sets, cap_sets;
+    bool       error;
+    bool       icase;           /* letters match either case */
+} parser_t;
+
+
+static int parse_alt(parser_t *);
+
+
+/*------------------------------ byte sets ------------------------------*/
+
+static void set_add(byteset_t *s, unsigned char c) {
+    s->bits[c >> 6] |= (uint64_t) 1 << (c & 63);
+}
+
+static bool set_has(const byteset_t *s, unsigned char c) {
+    return (s->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+/* adds the other case of every ASCII letter in the set */
+static void set_fold(byteset_t *s) {
+    for (int c = 'a'; c <= 'z'; c++) {
+        if (set_has(s, c) || set_has(s, c ^ 0x20)) {
+            set_add(s, c);
+            set_add(s, c ^ 0x20);
+        }
+    }
+}
+
+static void set_add_class(byteset_t *s, int (*is_class)(int), bool negate) {
+    for (int c = 0; c < 256; c++) {
+        if ((is_class(c) != 0) != negate) set_add(s, c);
+    }
+}
+
+static int is_word(int c) {
+    return isalnum(c) || c == '_';
+}
+
+
+/*------------------------------- parsing -------------------------------*/
+
+static int new_node(parser_t *ps, node_type typ, int left, int right) {
+    if (ps->error || left == -1 || right == -1) {
+        ps->error = true;
+        return -1;
+    }
+
+    if (ps->num_nodes == ps->cap_nodes) {
+        int cap = (ps->cap_nodes == 0) ? 32 : ps->cap_nodes * 2;
+        node_t *tmp = realloc(ps->nodes, sizeof(node_t) * cap);
+
+        if (tmp == NULL) {
+            /* realloc failed */
+            ps->error = true;
+            return -1;
+        }
+
+        ps->nodes = tmp;
+        ps->cap_nodes = cap;
+    }
+
+    node_t *n = &ps->nodes[ps->num_nodes];
+    n->typ = typ;
+    n->left = left;
+    n->right = right;
+    n->min = n->max = 0;
+    n->set = -1;
+
+    return ps->num_nodes++;
+}
+
+
+/* adds an empty byte set and a node matching it; returns the node */
+static int new_set_node(parser_t *ps, byteset_t **set) {
+    if (ps->num_sets == ps->cap_sets) {
+        int cap = (ps->cap_sets == 0) ? 16 : ps->cap_sets * 2;
+        byteset_t *tmp = realloc(ps->sets, sizeof(byteset_t) * cap);
+
+        if (tmp == NULL) {
+            /* realloc failed */
+            ps->error = true;
+            return -1;
+        }
+
+        ps->sets = tmp;
+        ps->cap_sets = cap;
+    }
+
+    int n = new_node(ps, N_SET, 0, 0);
+    if (n == -1) return -1;
+
+    ps->nodes[n].set = ps->num_sets;
+    *set = &ps->sets[ps->num_sets++];
+    memset(*set, 0, sizeof(byteset_t));
+
+    return n;
+}
+
+
+/* handles \d, \w, \s and their negations; returns false for anything else */
+static bool escape_class(byteset_t *s, char c) {
+    switch (c) {
+        case 'd': set_add_class(s, isdigit, false); return true;
+        case 'D': set_add_class(s, isdigit, true);  return true;
+        case 'w': set_add_class(s, is_word, false); return true;
+        case 'W': set_add_class(s, is_word, true);  return true;
+        case 's': set_add_class(s, isspace, false); return true;
+        case 'S': set_add_class(s, isspace, true);  return true;
+    }
+
+    return false;
+}
+
+
+/* the byte an escape sequence stands for */
+static unsigned char escape_byte(char c) {
+    switch (c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+    }
+
+    return c;
+}
+
+
+/* parses a [:name:] class at pos; returns false if the name is unknown */
+static bool named_class(parser_t *ps, byteset_t *s) {
+    static const struct {
+        const char *name;
+        int (*is_class)(int);
+    } names[] = {
+        { "[:alpha:]",  isalpha  }, { "[:digit:]", isdigit }, { "[:alnum:]", isalnum },
+        { "[:upper:]",  isupper  }, { "[:lower:]", islower }, { "[:space:]", isspace },
+        { "[:blank:]",  isblank  }, { "[:punct:]", ispunct }, { "[:print:]", isprint },
+        { "[:graph:]",  isgraph  }, { "[:cntrl:]", iscntrl }, { "[:xdigit:]", isxdigit },
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        size_t len = strlen(names[i].name);
+
+        if (strncmp(ps->pos, names[i].name, len) == 0) {
+            set_add_class(s, names[i].is_class, false);
+            ps->pos += len;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/* parses a bracket expression; pos is just past the opening '[' */
+static int parse_class(parser_t *ps) {
+    byteset_t *s;
+    int n = new_set_node(ps, &s);
+    if (n == -1) return -1;
+
+    bool negate = false;
+    if (*ps->pos == '^') {
+        negate = true;
+        ps->pos++;
+    }
+
+    bool first = true;
+
+    while (*ps->pos != ']' || first) {
+        if (*ps->pos == '\0') {
+            /* unterminated bracket expression */
+            ps->error = true;
+            return -1;
+        }
+
+        first = false;
+
+        if (*ps->pos == '[' && ps->pos[1] == ':') {
+            if (!named_class(ps, s)) {
+                ps->error = true;
+                return -1;
+            }
+            continue;
+        }
+
+        unsigned char lo = *ps->pos++;
+
+        if (lo == '\\' && *ps->pos != '\0') {
+            if (escape_class(s, *ps->pos)) {
+                ps->pos++;
+                continue;
+            }
+            lo = escape_byte(*ps->pos++);
+        }
+
+        unsigned char hi = lo;
+
+        if (ps->pos[0] == '-' && ps->pos[1] != ']' && ps->pos[1] != '\0') {
+            /* a range of bytes */
+            ps->pos++;
+            hi = *ps->pos++;
+
+            if (hi == '\\' && *ps->pos != '\0') hi = escape_byte(*ps->pos++);
+
+            if (hi < lo) {
+                ps->error = true;
+                return -1;
+            }
+        }
+
+        for (int c = lo; c <= hi; c++) set_add(s, c);
+    }
+
+    ps->pos++;                  /* skip the closing ']' */
+
+    /* fold before negating, so [^a] excludes both cases */
+    if (ps->icase) set_fold(s);
+
+    if (negate) {
+        for (int i = 0; i < 4; i++) s->bits[i] = ~s->bits[i];
+    }
+
+    return n;
+}
+
+
+static int parse_atom(parser_t *ps) {
+    byteset_t *s;
+    int n;
+    char c = *ps->pos++;
+
+    switch (c) {
+        case '(':
+            n = parse_alt(ps);
+
+            if (*ps->pos != ')') {
+                /* unbalanced parenthesis */
+                ps->error = true;
+                return -1;
+            }
+
+            ps->pos++;
+            return n;
+
+        case '[':
+            return parse_class(ps);
+
+        case '^':
+            return new_node(ps, N_BOL, 0, 0);
+
+        case '$':
+            return new_node(ps, N_EOL, 0, 0);
+
+        case '.':
+            n = new_set_node(ps, &s);
+            if (n == -1) return -1;
+
+            memset(s->bits, 0xff, sizeof(s->bits));
+            return n;
+
+        case '\\':
+            if (*ps->pos == '\0') {
+                /* trailing backslash */
+                ps->error = true;
+                return -1;
+            }
+
+            n = new_set_node(ps, &s);
+            if (n == -1) return -1;
+
+            c = *ps->pos++;
+            if (!escape_class(s, c)) set_add(s, escape_byte(c));
+            return n;
+
+        default:
+            /* anything else (including a stray repetition operator) is literal */
+            n = new_set_node(ps, &s);
+            if (n == -1) return -1;
+
+            set_add(s, c);
+            return n;
+    }
+}
+
+
+/* parses a {n}, {n,} or {n,m} bound; leaves pos alone if there isn't one */
+static bool parse_bound(parser_t *ps, int *min, int *max) {
+    const char *p = ps->pos + 1;
+
+    if (!isdigit((unsigned char) *p)) return false;
+
+    *min = strtol(p, (char **) &p, 10);
+    *max = *min;
+
+    if (*p == ',') {
+        p++;
+        *max = -1;
+
+        if (isdigit((unsigned char) *p)) *max = strtol(p, (char **) &p, 10);
+    }
+
+    if (*p != '}') return false;
+
+    if (*min > MAX_REPEAT || *max > MAX_REPEAT || (*max != -1 && *max < *min)) {
+        ps->error = true;
+        return false;
+    }
+
+    ps->pos = p + 1;
+    return true;
+}
+
+
+static int parse_repeat(parser_t *ps) {
+    int n = parse_atom(ps);
+    int min, max;
+
+    while (n != -1) {
+        char c = *ps->pos;
+
+        if (c == '*') {
+            n = new_node(ps, N_STAR, n, 0);
+        } else if (c == '+') {
+            n = new_node(ps, N_PLUS, n, 0);
+        } else if (c == '?') {
+            n = new_node(ps, N_QUEST, n, 0);
+        } else if (c == '{' && parse_bound(ps, &min, &max)) {
+            n = new_node(ps, N_REPEAT, n, 0);
+            if (n != -1) {
+                ps->nodes[n].min = min;
+                ps->nodes[n].max = max;
+            }
+            continue;
+        } else {
+            /* a '{' that doesn't start a bound is a literal */
+            break;
+        }
+
+        ps->pos++;
+    }
+
+    return ps->error ? -1 : n;
+}
+
+
+static int parse_concat(parser_t *ps) {
+    int n = -1;
+
+    while (*ps->pos != '\0' && *ps->pos != '|' && *ps->pos != ')') {
+        int next = parse_repeat(ps);
+        if (next == -1) return -1;
+
+        n = (n == -1) ? next : new_node(ps, N_CAT, n, next);
+    }
+
+    return (n == -1) ? new_node(ps, N_EMPTY, 0, 0) : n;
+}
+
+
+static int parse_alt(parser_t *ps) {
+    int n = parse_concat(ps);
+
+    while (n != -1 && *ps->pos == '|') {
+        ps->pos++;
+        n = new_node(ps, N_ALT, n, parse_concat(ps));
+    }
+
+    return n;
+}
+
+
+/*------------------------------ compiling ------------------------------*/
+
+static int emit(re_prog_t *p, int *cap, op_type op, int x, int y) {
+    if (p->num_insts == *cap) {
+        if (*cap >= MAX_PROG) return -1;
+
+        int new_cap = (*cap == 0) ? 64 : *cap * 2;
+        inst_t *tmp = realloc(p->insts, sizeof(inst_t) * new_cap);
+
+        if (tmp == NULL) {
+            /* realloc failed */
+            return -1;
+        }
+
+        p->insts = tmp;
+        *cap = new_cap;
+    }
+
+    p->insts[p->num_insts].op = op;
+    p->insts[p->num_insts].x = x;
+    p->insts[p->num_insts].y = y;
+
+    return p->num_insts++;
+}
+
+
+/* emits the Thompson construction for a node; returns false on failure */
+static bool compile_node(re_prog_t *p, int *cap, const node_t *nodes, int n) {
+    const node_t *node = &nodes[n];
+    int split, jmp;
+
+    switch (node->typ) {
+        case N_EMPTY:
+            return true;
+
+        case N_SET:
+            return emit(p, cap, OP_SET, node->set, 0) != -1;
+
+        case N_BOL:
+            return emit(p, cap, OP_BOL, 0, 0) != -1;
+
+        case N_EOL:
+            return emit(p, cap, OP_EOL, 0, 0) != -1;
+
+        case N_CAT:
+            return compile_node(p, cap, nodes, node->left) &&
+                   compile_node(p, cap, nodes, node->right);
+
+        case N_ALT:
+            if ((split = emit(p, cap, OP_SPLIT, 0, 0)) == -1) return false;
+            p->insts[split].x = p->num_insts;
+            if (!compile_node(p, cap, nodes, node->left)) return false;
+            if ((jmp = emit(p, cap, OP_JMP, 0, 0)) == -1) return false;
+            p->insts[split].y = p->num_insts;
+            if (!compile_node(p, cap, nodes, node->right)) return false;
+            p->insts[jmp].x = p->num_insts;
+            return true;
+
+        case N_STAR:
+            if ((split = emit(p, cap, OP_SPLIT, 0, 0)) == -1) return false;
+            p->insts[split].x = p->num_insts;
+            if (!compile_node(p, cap, nodes, node->left)) return false;
+            if (emit(p, cap, OP_JMP, split, 0) == -1) return false;
+            p->insts[split].y = p->num_insts;
+            return true;
+
+        case N_PLUS:
+            jmp = p->num_insts;
+            if (!compile_node(p, cap, nodes, node->left)) return false;
+            if ((split = emit(p, cap, OP_SPLIT, jmp, 0)) == -1) return false;
+            p->insts[split].y = p->num_insts;
+            return true;
+
+        case N_QUEST:
+            if ((split = emit(p, cap, OP_SPLIT, 0, 0)) == -1) return false;
+            p->insts[split].x = p->num_insts;
+            if (!compile_node(p, cap, nodes, node->left)) return false;
+            p->insts[split].y = p->num_insts;
+            return true;
+
+        case N_REPEAT:
+            /* spell out the required copies, then the optional ones */
+            for (int i = 0; i < node->min; i++) {
+                if (!compile_node(p, cap, nodes, node->left)) return false;
+            }
+
+            if (node->max == -1) {
+                if ((split = emit(p, cap, OP_SPLIT, 0, 0)) == -1) return false;
+                p->insts[split].x = p->num_insts;
+                if (!compile_node(p, cap, nodes, node->left)) return false;
+                if (emit(p, cap, OP_JMP, split, 0) == -1) return false;
+                p->insts[split].y = p->num_insts;
+                return true;
+            }
+
+            for (int i = node->min; i < node->max; i++) {
+                if ((split = emit(p, cap, OP_SPLIT, 0, 0)) == -1) return false;
+                p->insts[split].x = p->num_insts;
+                if (!compile_node(p, cap, nodes, node->left)) return false;
+                p->insts[split].y = p->num_insts;
+            }
+            return true;
+    }
+
+    /* we should never reach here */
+    return false;
+}
+
+
+/* single byte matched by a set node, or -1 if it matches more (or less) */
+static int single_byte(const parser_t *ps, const node_t *node) {
+    if (node->typ != N_SET) return -1;
+
+    int byte = -1;
+
+    for (int c = 0; c < 256; c++) {
+        if (!set_has(&ps->sets[node->set], c)) continue;
+        if (byte != -1) return -1;
+        byte = c;
+    }
+
+    return byte;
+}
+
+
+/* appends the literal bytes every match of the node starts with; returns true
+ * if the whole node was literal, so that whatever follows can be appended */
+static bool extract_prefix(const parser_t *ps, int n, re_prog_t *p, bool *anchored) {
+    const node_t *node = &ps->nodes[n];
+    int byte;
+
+    switch (node->typ) {
+        case N_EMPTY:
+            return true;
+
+        case N_BOL:
+            /* zero width, and can only sit in front of the prefix */
+            *anchored = true;
+            return p->prefix_len == 0;
+
+        case N_SET:
+            if ((byte = single_byte(ps, node)) == -1) return false;
+            p->prefix[p->prefix_len++] = byte;
+            return true;
+
+        case N_CAT:
+            return extract_prefix(ps, node->left, p, anchored) &&
+                   extract_prefix(ps, node->right, p, anchored);
+
+        case N_PLUS:
+        case N_REPEAT:
+            /* at least one copy is required, but what follows is unknown */
+            if ((node->typ == N_PLUS || node->min > 0) &&
+                (byte = single_byte(ps, &ps->nodes[node->left])) != -1) {
+                p->prefix[p->prefix_len++] = byte;
+            }
+            return false;
+
+        default:
+            return false;
+    }
+}
+
+
+/* adds the closure of pc to list, following OP_BOL only at a line start and
+ * OP_EOL only at a line end */
+static void closure(const re_prog_t *p, int pc, bool bol, bool eol, uint32_t *mark,
+                    uint32_t gen, int *stack, int *list, int *num_list) {
+    int top = 0;
+    stack[top++] = pc;
+
+    while (top > 0) {
+        pc = stack[--top];
+
+        if (mark[pc] == gen) continue;
+        mark[pc] = gen;
+
+        const inst_t *inst = &p->insts[pc];
+
+        switch (inst->op) {
+            case OP_JMP:
+                stack[top++] = inst->x;
+                break;
+
+            case OP_SPLIT:
+                /* push y first so that x is explored first */
+                stack[top++] = inst->y;
+                stack[top++] = inst->x;
+                break;
+
+            case OP_BOL:
+                if (bol) stack[top++] = pc + 1;
+                break;
+
+            case OP_EOL:
+                if (eol) {
+                    stack[top++] = pc + 1;
+                } else {
+                    list[(*num_list)++] = pc;
+                }
+                break;
+
+            default:
+                list[(*num_list)++] = pc;
+                break;
+        }
+    }
+}
+
+
+/* splits the bytes into classes that no set of the program tells apart */
+static void build_classes(re_prog_t *p) {
+    int map[512];
+
+    memset(p->classes, 0, sizeof(p->classes));
+    p->classes['\n'] = 1;       /* newlines always get a class to themselves */
+    p->num_classes = 2;
+
+    for (int s = 0; s < p->num_sets; s++) {
+        int num = 0;
+
+        for (int i = 0; i < 512; i++) map[i] = -1;
+
+        for (int c = 0; c < 256; c++) {
+            int key = p->classes[c] * 2 + set_has(&p->sets[s], c);
+            if (map[key] == -1) map[key] = num++;
+            p->classes[c] = map[key];
+        }
+
+        p->num_classes = num;
+    }
+
+    for (int c = 255; c >= 0; c--) {
+        p->reps[p->classes[c]] = c;
+    }
+}
+
+
+re_prog_t *re_compile(const char *pattern, bool icase) {
+    parser_t ps = { pattern, NULL, 0, 0, NULL, 0, 0, false, icase };
+
+    int root = parse_alt(&ps);
+
+    if (root == -1 || ps.error || *ps.pos != '\0') {
+        /* syntax error, or a stray ')' */
+        free(ps.nodes);
+        free(ps.sets);
+        return NULL;
+    }
+
+    re_prog_t *p = calloc(1, sizeof(re_prog_t));
+
+    if (p == NULL) {
+        /* calloc failed */
+        free(ps.nodes);
+        free(ps.sets);
+        return NULL;
+    }
+
+    int cap = 0;
+    p->sets = ps.sets;
+    p->num_sets = ps.num_sets;
+
+    /* lines never contain a newline, so no set needs to match one */
+    for (int i = 0; i < p->num_sets; i++) {
+        p->sets[i].bits['\n' >> 6] &= ~((uint64_t) 1 << ('\n' & 63));
+
+        /* bracket expressions were folded already; this catches the rest */
+        if (icase) set_fold(&p->sets[i]);
+    }
+
+    bool ok = compile_node(p, &cap, ps.nodes, root) &&
+              emit(p, &cap, OP_MATCH, 0, 0) != -1;
+
+    /* a prefix is at most one byte per set node */
+    p->prefix = malloc(ps.num_sets + 1);
+    ok = ok && p->prefix != NULL;
+
+    if (ok) {
+        bool anchored = false;
+        p->literal = extract_prefix(&ps, root, p, &anchored) && !anchored;
+    }
+
+    free(ps.nodes);
+
+    if (!ok) {
+        re_free(p);
+        return NULL;
+    }
+
+    build_classes(p);
+
+    /* check whether the pattern can match at a line start without consuming
+     * anything, in which case every single line matches */
+    uint32_t *mark = calloc(p->num_insts, sizeof(uint32_t));
+    int *stack = malloc(sizeof(int) * (2 * p->num_insts + 1));
+    int *list = malloc(sizeof(int) * p->num_insts);
+    int num_list = 0;
+
+    if (mark == NULL || stack == NULL || list == NULL) {
+        free(mark);
+        free(stack);
+        free(list);
+        re_free(p);
+        return NULL;
+    }
+
+    closure(p, 0, true, false, mark, 1, stack, list, &num_list);
+
+    for (int i = 0; i < num_list; i++) {
+        if (p->insts[list[i]].op == OP_MATCH) p->every_line = true;
+    }
+
+    free(mark);
+    free(stack);
+    free(list);
+
+    return p;
+}
+
+
+void re_free(re_prog_t *p) {
+    if (p == NULL) return;
+
+    free(p->insts);
+    free(p->sets);
+    free(p->prefix);
+    free(p);
+}
+
+
+const char *re_literal(const re_prog_t *p, size_t *len) {
+    if (!p->literal) return NULL;
+
+    *len = p->prefix_len;
+    return p->prefix;
+}
+
+
+const char *re_prefix(const re_prog_t *p, size_t *len) {
+    if (p->prefix_len == 0) return NULL;
+
+    *len = p->prefix_len;
+    return p->prefix;
+}
+
+
+/*------------------------------ lazy DFA -------------------------------*/
+
+re_dfa_t *re_dfa_new(const re_prog_t *p) {
+    re_dfa_t *d = calloc(1, sizeof(re_dfa_t));
+
+    if (d == NULL) {
+        /* calloc failed */
+        return NULL;
+    }
+
+    d->prog = p;
+    d->max_states = DFA_CACHE_SIZE / (sizeof(int32_t) * p->num_classes);
+    if (d->max_states < MIN_STATES) d->max_states = MIN_STATES;
+
+    d->table_size = 1;
+    while (d->table_size < 2 * (size_t) d->max_states) d->table_size <<= 1;
+
+    d->trans = malloc(sizeof(int32_t) * p->num_classes * d->max_states);
+    d->states = malloc(sizeof(dstate_t) * d->max_states);
+    d->table = malloc(sizeof(int) * d->table_size);
+    d->mark = calloc(p->num_insts, sizeof(uint32_t));
+    d->stack = malloc(sizeof(int) * (2 * p->num_insts + 1));
+    d->list = malloc(sizeof(int) * (p->num_insts + 1));
+
+    if (d->trans == NULL || d->states == NULL || d->table == NULL ||
+        d->mark == NULL || d->stack == NULL || d->list == NULL) {
+        re_dfa_free(d);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < d->table_size; i++) d->table[i] = -1;
+    d->line_start = -1;
+
+    return d;
+}
+
+
+void re_dfa_free(re_dfa_t *d) {
+    if (d == NULL) return;
+
+    free(d->trans);
+    free(d->states);
+    free(d->pcs);
+    free(d->table);
+    free(d->mark);
+    free(d->stack);
+    free(d->list);
+    free(d);
+}
+
+
+/* throws every cached state away */
+static void flush_cache(re_dfa_t *d) {
+    for (size_t i = 0; i < d->table_size; i++) d->table[i] = -1;
+
+    d->num_states = 0;
+    d->num_pcs = 0;
+    d->line_start = -1;
+    d->flushes++;
+}
+
+
+static int compare_pcs(const void *a, const void *b) {
+    return *(const int *) a - *(const int *) b;
+}
+
+
+/* returns the state for the pc set in d->list, adding it if it's new. This
+ * may flush the cache, invalidating every other state index */
+static int add_state(re_dfa_t *d) {
+    const re_prog_t *p = d->prog;
+    int n = d->num_list;
+
+    qsort(d->list, n, sizeof(int), compare_pcs);
+
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < n; i++) {
+        hash = (hash ^ (uint32_t) d->list[i]) * 16777619u;
+    }
+
+    size_t mask = d->table_size - 1;
+    size_t slot = hash & mask;
+
+    for (; d->table[slot] != -1; slot = (slot + 1) & mask) {
+        dstate_t *st = &d->states[d->table[slot]];
+
+        if (st->hash == hash && st->len == n &&
+            memcmp(&d->pcs[st->off], d->list, sizeof(int) * n) == 0) {
+            return d->table[slot];
+        }
+    }
+
+    if (d->num_states == d->max_states) {
+        /* cache is full; start over */
+        flush_cache(d);
+        slot = hash & mask;
+    }
+
+    if (d->num_pcs + n > d->cap_pcs) {
+        size_t cap = (d->cap_pcs == 0) ? 1024 : d->cap_pcs;
+        while (cap < d->num_pcs + n) cap *= 2;
+
+        int *tmp = realloc(d->pcs, sizeof(int) * cap);
+
+        if (tmp == NULL) {
+            /* realloc failed; nothing sensible left to do */
+            abort();
+        }
+
+        d->pcs = tmp;
+        d->cap_pcs = cap;
+    }
+
+    int idx = d->num_states++;
+    dstate_t *st = &d->states[idx];
+
+    st->off = d->num_pcs;
+    st->len = n;
+    st->hash = hash;
+    st->accept = false;
+    st->accept_eol = false;
+
+    memcpy(&d->pcs[st->off], d->list, sizeof(int) * n);
+    d->num_pcs += n;
+
+    for (int i = 0; i < p->num_classes; i++) {
+        d->trans[idx * p->num_classes + i] = UNKNOWN;
+    }
+
+    d->table[slot] = idx;
+
+    /* work out whether the state matches now, or would at the end of a line;
+     * a line that ends right at its start is also still at its start */
+    bool at_line_start = (n > 0 && d->pcs[st->off + n - 1] == LINE_START(p));
+
+    d->num_list = 0;
+    d->gen++;
+
+    for (int i = 0; i < n; i++) {
+        int pc = d->pcs[st->off + i];
+
+        if (pc == LINE_START(p)) continue;
+
+        if (p->insts[pc].op == OP_MATCH) st->accept = true;
+
+        if (p->insts[pc].op == OP_EOL) {
+            closure(p, pc + 1, at_line_start, true, d->mark, d->gen,
+                    d->stack, d->list, &d->num_list);
+        }
+    }
+
+    for (int i = 0; i < d->num_list; i++) {
+        if (p->insts[d->list[i]].op == OP_MATCH) st->accept_eol = true;
+    }
+
+    return idx;
+}
+
+
+static int line_start_state(re_dfa_t *d) {
+    if (d->line_start == -1) {
+        d->num_list = 0;
+        d->gen++;
+        closure(d->prog, 0, true, false, d->mark, d->gen, d->stack, d->list, &d->num_list);
+
+        /* keep the state apart from any mid-line state with the same pcs */
+        d->list[d->num_list++] = LINE_START(d->prog);
+
+        d->line_start = add_state(d);
+    }
+
+    return d->line_start;
+}
+
+
+/* computes (and caches) the transition out of state s on byte class cls */
+static int step(re_dfa_t *d, int s, int cls) {
+    const re_prog_t *p = d->prog;
+    uint32_t flushes = d->flushes;
+    unsigned char c = p->reps[cls];
+    int result;
+
+    if (c == '\n') {
+        /* the line is over: either it matched at its end, or start afresh */
+        result = d->states[s].accept_eol ? MATCHED : line_start_state(d);
+    } else {
+        const dstate_t *st = &d->states[s];
+
+        d->num_list = 0;
+        d->gen++;
+
+        for (int i = 0; i < st->len; i++) {
+            int pc = d->pcs[st->off + i];
+
+            if (pc == LINE_START(p)) continue;
+
+            const inst_t *inst = &p->insts[pc];
+
+            if (inst->op == OP_SET && set_has(&p->sets[inst->x], c)) {
+                closure(p, pc + 1, false, false, d->mark, d->gen, d->stack, d->list, &d->num_list);
+            }
+        }
+
+        /* a match may also begin at the next byte */
+        closure(p, 0, false, false, d->mark, d->gen, d->stack, d->list, &d->num_list);
+
+        int next = add_state(d);
+        result = d->states[next].accept ? MATCHED : next;
+    }
+
+    if (flushes == d->flushes) {
+        /* s is still valid, so the transition can be remembered */
+        d->trans[s * p->num_classes + cls] = result;
+    }
+
+    return result;
+}
+
+
+/* runs the DFA over whole lines; returns a pointer into the first match */
+static const char *run_dfa(re_dfa_t *d, const char *start, const char *end) {
+    const uint8_t *classes = d->prog->classes;
+    int nc = d->prog->num_classes;
+    const unsigned char *p = (const unsigned char *) start;
+    int s = line_start_state(d);
+
+    for (; p < (const unsigned char *) end; p++) {
+        int next = d->trans[s * nc + classes[*p]];
+
+        if (next < 0) {
+            if (next == UNKNOWN) next = step(d, s, classes[*p]);
+            if (next == MATCHED) return (const char *) p;
+        }
+
+        s = next;
+    }
+
+    /* the last line may end without a newline */
+    if (end > start && end[-1] != '\n' && d->states[s].accept_eol) {
+        return end - 1;
+    }
+
+    return NULL;
+}
+
+
+const char *re_find(re_dfa_t *d, const char *start, const char *end) {
+    const re_prog_t *prog = d->prog;
+
+    if (prog->every_line) return (start < end) ? start : NULL;
+
+    if (prog->prefix_len == 0) return run_dfa(d, start, end);
+
+    /* only lines holding the prefix can match */
+    const char *p = start;
+
+    while (p < end) {
+        const char *lit = scan_literal(p, end - p, prog->prefix, prog->prefix_len);
+
+        if (lit == NULL) return NULL;
+
+        const char *line_start = memrchr(p, '\n', lit - p);
+        line_start = (line_start == NULL) ? p : line_start + 1;
+
+        const char *line_end = memchr(lit, '\n', end - lit);
+        line_end = (line_end == NULL) ? end : line_end + 1;
+
+        const char *match = run_dfa(d, line_start, line_end);
+        if (match != NULL) return match;
+
+        p = line_end;
+    }
+
+    return NULL;
+}
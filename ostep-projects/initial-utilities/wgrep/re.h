@@ -0,0 +1,63 @@
+#ifndef RE_H_
+#define RE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Extended regular expressions, matched one line at a time.
+ *
+ * A pattern is parsed and compiled into a Thompson NFA (re_prog_t), which is
+ * read-only and can be shared between threads. Matching runs a DFA that is
+ * built lazily from the NFA, one state per new set of NFA states met, and is
+ * kept in a bounded cache (re_dfa_t) that belongs to a single thread. When
+ * the cache fills up it is flushed and rebuilt from where the scan is, so
+ * matching always takes time linear in the input, with no backtracking.
+ *
+ * Supported syntax: literals, `.`, bracket expressions (ranges, negation and
+ * [:class:] names), `\d \w \s` and their negations, `*`, `+`, `?`, `{n,m}`,
+ * `|`, grouping with parentheses, and the `^` / `$` line anchors.
+ **/
+
+typedef struct re_prog re_prog_t;
+
+typedef struct re_dfa re_dfa_t;
+
+
+/**
+ * Compiles the pattern; with icase set, ASCII letters match either case.
+ * Returns NULL if it isn't a valid regular expression (or memory ran out).
+ **/
+re_prog_t *re_compile(const char*, bool icase);
+
+void re_free(re_prog_t*);
+
+/**
+ * If the whole pattern is just a literal string, returns it (and its length
+ * in len) so that the literal scanner can be used instead. Returns NULL
+ * otherwise.
+ **/
+const char *re_literal(const re_prog_t*, size_t *len);
+
+/**
+ * Returns the literal string every match starts with (and its length in
+ * len), or NULL if the pattern has no such prefix.
+ **/
+const char *re_prefix(const re_prog_t*, size_t *len);
+
+/* creates an empty DFA cache for the program */
+re_dfa_t *re_dfa_new(const re_prog_t*);
+
+void re_dfa_free(re_dfa_t*);
+
+/**
+ * Returns a pointer into the first line of [start, end) that matches, or
+ * NULL if none does. start must be at the beginning of a line.
+ *
+ * When the pattern begins with a literal string, that prefix is located
+ * with the literal scanner first and only the lines holding it are run
+ * through the DFA.
+ **/
+const char *re_find(re_dfa_t*, const char *start, const char *end);
+
+#endif // RE_H_
@@ -0,0 +1,178 @@
+#include "scan.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* lower-cases ASCII letters and leaves every other byte alone */
+static inline unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (c | 0x20) : c;
+}
+
+/* the bit that separates an ASCII letter's cases, or 0 for other bytes */
+static inline unsigned char case_bit(unsigned char c) {
+    c = fold(c);
+    return (c >= 'a' && c <= 'z') ? 0x20 : 0;
+}
+
+
+static bool equal_icase(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (fold(a[i]) != fold(b[i])) return false;
+    }
+
+    return true;
+}
+
+
+const char *scan_literal(const char *hay, size_t hay_len,
+                         const char *needle, size_t needle_len) {
+    if (needle_len == 0) return hay;
+    if (needle_len > hay_len) return NULL;
+    if (needle_len == 1) return memchr(hay, needle[0], hay_len);
+
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[needle_len - 1]);
+
+    /* both loads of a block must stay inside the haystack */
+    for (; i + needle_len - 1 + 16 <= hay_len; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *) (hay + i));
+        __m128i block_last  = _mm_loadu_si128((const __m128i *) (hay + i + needle_len - 1));
+
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                                        _mm_cmpeq_epi8(block_last, last)));
+
+        while (mask != 0) {
+            unsigned bit = __builtin_ctz(mask);
+
+            /* first and last bytes already match; check what lies between */
+            if (memcmp(hay + i + bit + 1, needle + 1, needle_len - 2) == 0) {
+                return hay + i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    /* leftover tail (or the whole haystack without SSE2) */
+    return memmem(hay + i, hay_len - i, needle, needle_len);
+}
+
+
+const char *scan_literal_icase(const char *hay, size_t hay_len,
+                               const char *needle, size_t needle_len) {
+    if (needle_len == 0) return hay;
+    if (needle_len > hay_len) return NULL;
+
+    unsigned char first = needle[0];
+    unsigned char last = needle[needle_len - 1];
+
+    if (needle_len == 1 && case_bit(first) == 0) return memchr(hay, first, hay_len);
+
+    size_t i = 0;
+
+#ifdef __SSE2__
+    if (needle_len == 1) {
+        /* a single letter: compare each block with both of its cases */
+        const __m128i lower = _mm_set1_epi8(fold(first));
+        const __m128i upper = _mm_set1_epi8(fold(first) & ~0x20);
+
+        /* two blocks a time, so only one branch per 32 bytes */
+        for (; i + 32 <= hay_len; i += 32) {
+            __m128i block_lo = _mm_loadu_si128((const __m128i *) (hay + i));
+            __m128i block_hi = _mm_loadu_si128((const __m128i *) (hay + i + 16));
+
+            __m128i hit_lo = _mm_or_si128(_mm_cmpeq_epi8(block_lo, lower),
+                                          _mm_cmpeq_epi8(block_lo, upper));
+            __m128i hit_hi = _mm_or_si128(_mm_cmpeq_epi8(block_hi, lower),
+                                          _mm_cmpeq_epi8(block_hi, upper));
+
+            unsigned mask = _mm_movemask_epi8(hit_lo) | (_mm_movemask_epi8(hit_hi) << 16);
+
+            if (mask != 0) return hay + i + __builtin_ctz(mask);
+        }
+    }
+
+    /**
+     * OR-ing in the case bit folds both cases of a letter to lower case. It's
+     * only applied at the needle's letters, and there the only bytes that
+     * fold onto the letter are its two cases, so the filter stays exact.
+     **/
+    const __m128i first_bit = _mm_set1_epi8(case_bit(first));
+    const __m128i last_bit  = _mm_set1_epi8(case_bit(last));
+    const __m128i first_vec = _mm_set1_epi8(first | case_bit(first));
+    const __m128i last_vec  = _mm_set1_epi8(last | case_bit(last));
+
+    for (; needle_len > 1 && i + needle_len - 1 + 16 <= hay_len; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *) (hay + i));
+        __m128i block_last  = _mm_loadu_si128((const __m128i *) (hay + i + needle_len - 1));
+
+        block_first = _mm_or_si128(block_first, first_bit);
+        block_last  = _mm_or_si128(block_last, last_bit);
+
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first_vec),
+                                                        _mm_cmpeq_epi8(block_last, last_vec)));
+
+        while (mask != 0) {
+            unsigned bit = __builtin_ctz(mask);
+
+            /* first and last bytes already match; check what lies between */
+            if (needle_len <= 2 ||
+                equal_icase(hay + i + bit + 1, needle + 1, needle_len - 2)) {
+                return hay + i + bit;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    /* leftover tail (or the whole haystack without SSE2) */
+    for (; i + needle_len <= hay_len; i++) {
+        if (fold(hay[i]) == fold(first) && equal_icase(hay + i + 1, needle + 1, needle_len - 1)) {
+            return hay + i;
+        }
+    }
+
+    return NULL;
+}
+
+
+size_t count_newlines(const char *buf, size_t len) {
+    size_t count = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+
+    while (i + 16 <= len) {
+        /* a byte lane can count at most 255 newlines before it wraps */
+        size_t blocks = (len - i) / 16;
+        if (blocks > 255) blocks = 255;
+
+        __m128i lanes = zero;
+
+        for (size_t b = 0; b < blocks; b++, i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *) (buf + i));
+
+            /* a matching byte compares to -1, so subtracting adds one */
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, nl));
+        }
+
+        /* sum the sixteen lane counters into two 64 bit halves */
+        __m128i sums = _mm_sad_epu8(lanes, zero);
+        count += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+    }
+#endif
+
+    for (; i < len; i++) {
+        count += (buf[i] == '\n');
+    }
+
+    return count;
+}
@@ -0,0 +1,39 @@
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+/**
+ * Returns a pointer to the first occurrence of the needle within the
+ * haystack, or NULL if there is none. An empty needle matches at the very
+ * start of the haystack.
+ *
+ * On x86 the scan is vectorized: every 16 byte block is filtered by
+ * comparing the needle's first and last bytes at once, and only the
+ * surviving candidate positions are verified with memcmp().
+ **/
+const char *scan_literal(const char *hay, size_t hay_len,
+                         const char *needle, size_t needle_len);
+
+/**
+ * Like scan_literal(), but ASCII letters match either case. The vectorized
+ * filter folds the haystack's bytes to lower case with an OR before the
+ * compares, at the cost of one extra instruction per block. A needle that
+ * is a single letter is instead compared with both of its cases, 32 bytes
+ * at a time, with nothing left to verify.
+ **/
+const char *scan_literal_icase(const char *hay, size_t hay_len,
+                               const char *needle, size_t needle_len);
+
+/**
+ * Returns the number of newlines in buf[0, len).
+ *
+ * On x86 every 16 byte block is compared against '\n' at once, and the
+ * results are summed in per-byte counters that are only folded into the
+ * total every 255 blocks, so the loop does no per-line work at all.
+ **/
+size_t count_newlines(const char *buf, size_t len);
+
+#endif // SCAN_H_
@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+#include "scan.h"
+
+#define INITIAL_HITS 16
+
+/* counts line numbers lazily, from the last position it was asked about */
+typedef struct {
+    const char *data;
+    size_t     pos;             /* offset the count is known for */
+    long       line;            /* lines between the search start and pos */
+    bool       enabled;         /* only -n needs the count */
+} line_counter;
+
+
+void init_hits(hits_t *h) {
+    h->lines = NULL;
+    h->num = 0;
+    h->cap = 0;
+    h->count = 0;
+    h->newlines = 0;
+}
+
+
+void free_hits(hits_t *h) {
+    free(h->lines);
+    init_hits(h);
+}
+
+
+void clear_hits(hits_t *h) {
+    h->num = 0;
+    h->count = 0;
+    h->newlines = 0;
+}
+
+
+bool add_hit(hits_t *h, size_t off, size_t len, size_t lines, long lineno, bool context) {
+    if (!context) h->count += lines;
+
+    if (h->num > 0) {
+        line_t *prev = &h->lines[h->num - 1];
+
+        if (prev->off + prev->len == off && prev->context == context) {
+            /* lines directly follow the previous ones; extend them */
+            prev->len += len;
+            prev->lines += lines;
+            return true;
+        }
+    }
+
+    if (h->num == h->cap) {
+        size_t cap = (h->cap == 0) ? INITIAL_HITS : h->cap * 2;
+        line_t *tmp = realloc(h->lines, sizeof(line_t) * cap);
+
+        if (tmp == NULL) {
+            /* realloc failed */
+            return false;
+        }
+
+        h->lines = tmp;
+        h->cap = cap;
+    }
+
+    h->lines[h->num].off = off;
+    h->lines[h->num].len = len;
+    h->lines[h->num].lines = lines;
+    h->lines[h->num].lineno = lineno;
+    h->lines[h->num].context = context;
+    h->num++;
+
+    return true;
+}
+
+
+/* returns the number of the line starting at pos; pos may only move forward */
+static long line_at(line_counter *c, size_t pos) {
+    if (!c->enabled) return 0;
+
+    c->line += count_newlines(c->data + c->pos, pos - c->pos);
+    c->pos = pos;
+
+    return c->line;
+}
+
+
+/* returns the start of the line up to n lines before the one at pos */
+static size_t lines_back(const char *data, size_t pos, size_t floor,
+                         size_t n, size_t *found) {
+    size_t k = 0;
+
+    while (k < n && pos > floor) {
+        /* data[pos - 1] ends the previous line; find where it starts */
+        const char *nl = memrchr(data + floor, '\n', pos - 1 - floor);
+        pos = (nl == NULL) ? floor : (size_t) (nl - data + 1);
+        k++;
+    }
+
+    *found = k;
+    return pos;
+}
+
+
+/* records the after-context still owed, up to the line starting at limit */
+static bool add_after(const char *data, size_t limit, line_counter *lc,
+                      search_state_t *state, hits_t *hits) {
+    size_t from = state->floor;
+    size_t pos = from;
+    size_t k = 0;
+
+    while (k < state->pending_after && pos < limit) {
+        const char *nl = memchr(data + pos, '\n', limit - pos);
+        pos = (nl == NULL) ? limit : (size_t) (nl - data + 1);
+        k++;
+    }
+
+    if (k == 0) return true;
+
+    state->pending_after -= k;
+    state->floor = pos;
+
+    return add_hit(hits, from, pos - from, k, line_at(lc, from), true);
+}
+
+
+void init_search_state(search_state_t *state, const char *data, size_t start,
+                       match_ctx_t *ctx, const options_t *opts) {
+    state->floor = 0;
+    state->pending_after = 0;
+
+    if (opts->after == 0 || start == 0) return;
+
+    /* only a match in the last few lines can still be owed context */
+    size_t k;
+    const char *p = data + lines_back(data, start, 0, opts->after, &k);
+    const char *limit = data + start;
+    const char *last_end = NULL;
+
+    while (p < limit) {
+        const char *match = find_match(ctx, p, limit);
+
+        if (match == NULL) break;
+
+        const char *line_end = memchr(match, '\n', limit - match);
+        p = (line_end == NULL) ? limit : line_end + 1;
+        last_end = p;
+    }
+
+    if (last_end == NULL) return;
+
+    /* the lines between that match and start have already been printed */
+    state->floor = start;
+    state->pending_after = opts->after - count_newlines(last_end, limit - last_end);
+}
+
+
+bool search_buffer(const char *data, size_t start, size_t end,
+                   match_ctx_t *ctx, const options_t *opts,
+                   search_state_t *state, hits_t *hits, size_t max_lines) {
+    const char *p = data + start;
+    const char *limit = data + end;
+    line_counter lc = { data, start, 0, opts->line_numbers };
+
+    while (p < limit && hits->count < max_lines) {
+        const char *match = find_match(ctx, p, limit);
+
+        if (match == NULL) break;
+
+        /* widen the match out to the line holding it */
+        const char *line_start = memrchr(p, '\n', match - p);
+        line_start = (line_start == NULL) ? p : line_start + 1;
+
+        const char *line_end = memchr(match, '\n', limit - match);
+        line_end = (line_end == NULL) ? limit : line_end + 1;
+
+        size_t ls = line_start - data;
+        size_t le = line_end - data;
+
+        /* finish off the previous match's context before this one's */
+        if (!add_after(data, ls, &lc, state, hits)) return false;
+
+        if (opts->before > 0) {
+            size_t k;
+            size_t from = lines_back(data, ls, state->floor, opts->before, &k);
+
+            if (k > 0 && !add_hit(hits, from, ls - from, k, line_at(&lc, ls) - k, true)) {
+                return false;
+            }
+        }
+
+        if (!add_hit(hits, ls, le - ls, 1, line_at(&lc, ls), false)) {
+            return false;
+        }
+
+        state->floor = le;
+        state->pending_after = opts->after;
+
+        /* the rest of this line can't produce another hit */
+        p = line_end;
+    }
+
+    if (!add_after(data, end, &lc, state, hits)) return false;
+
+    hits->newlines = line_at(&lc, end);
+
+    return true;
+}
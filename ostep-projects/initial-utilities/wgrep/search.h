@@ -0,0 +1,82 @@
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "match.h"
+#include "options.h"
+
+/**
+ * A run of matching (or context) lines, stored as an offset into the
+ * searched data rather than a copy of it. The length includes the trailing
+ * newline, if there was one.
+ **/
+typedef struct {
+    size_t off;                 /* offset of the first line's first byte */
+    size_t len;                 /* length of the run in bytes */
+    size_t lines;               /* number of lines in the run */
+    long   lineno;              /* first line's number, relative to the search start */
+    bool   context;             /* the lines are context, not matches */
+} line_t;
+
+/**
+ * Growable list of the lines a search turned up, in the order they appear.
+ **/
+typedef struct {
+    line_t *lines;              /* the runs of lines themselves */
+    size_t num;                 /* number of runs in the list */
+    size_t cap;                 /* allocated capacity of the list */
+    size_t count;               /* total number of matching lines */
+    size_t newlines;            /* newlines in the searched range (for -n) */
+} hits_t;
+
+/**
+ * What a search has to carry over from the data before its range: how far
+ * lines have already been written, and how much after-context is still owed
+ * to a match that came before the range.
+ **/
+typedef struct {
+    size_t floor;               /* before-context never reaches below this offset */
+    size_t pending_after;       /* after-context lines still owed to an earlier match */
+} search_state_t;
+
+
+void init_hits(hits_t*);
+
+void free_hits(hits_t*);
+
+/* empties the list, but keeps its memory around for reuse */
+void clear_hits(hits_t*);
+
+/**
+ * Appends a run of lines to the list, merging it with the previous entry
+ * when the two are adjacent and of the same kind, so that runs of lines can
+ * be written at once. Returns false if memory could not be allocated.
+ **/
+bool add_hit(hits_t*, size_t off, size_t len, size_t lines, long lineno, bool context);
+
+/**
+ * Sets up the state for a search starting at data[start]. For -A, the few
+ * lines before start are checked for a match whose after-context runs on
+ * into the range, so a file can be searched in independent chunks.
+ **/
+void init_search_state(search_state_t*, const char *data, size_t start,
+                       match_ctx_t *ctx, const options_t *opts);
+
+/**
+ * Finds the lines of data[start, end) the context's matcher accepts and
+ * records them in hits, stopping once hits holds max_lines of them. The
+ * range must begin at the start of a line and end either at the end of the
+ * data or right after a newline.
+ *
+ * Context lines are found by walking back (or forward) from each match with
+ * memrchr() and memchr(), and line numbers by counting newlines between
+ * matches, so neither -n nor -A/-B adds any work for lines that are never
+ * printed. Before-context may reach below start, down to state->floor.
+ **/
+bool search_buffer(const char *data, size_t start, size_t end,
+                   match_ctx_t *ctx, const options_t *opts,
+                   search_state_t *state, hits_t *hits, size_t max_lines);
+
+#endif // SEARCH_H_
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "stream.h"
+#include "search.h"
+#include "output.h"
+
+#define READ_SIZE (1 << 20)     /* bytes asked for by every read() */
+
+
+int search_stream(int fd, const matcher_t *matcher, const options_t *opts) {
+    match_ctx_t *ctx = new_match_ctx(matcher);
+    size_t cap = 2 * READ_SIZE;
+    char *buf = malloc(cap);
+    size_t len = 0;             /* bytes held in buf */
+    size_t count = 0;           /* matching lines found so far */
+    bool eof = false;
+    size_t start = 0;           /* where the lines not yet searched begin */
+    long first_line = 1;        /* number of the line at start, for -n */
+    search_state_t state;
+    out_pos_t pos = { 0, false };
+    hits_t hits;
+
+    if (ctx == NULL || buf == NULL) {
+        out_error("wgrep: out of memory\n");
+    }
+
+    /* for -l and -q, one match answers the question */
+    size_t max_lines = (opts->list || opts->quiet) ? 1 : opts->max_count;
+
+    init_hits(&hits);
+    init_search_state(&state, buf, 0, ctx, opts);
+
+    /* past -m's limit, keep going only for the last match's after-context */
+    while (!eof && (count < max_lines || state.pending_after > 0)) {
+        if (cap - len < READ_SIZE) {
+            /* the partial line left over is too long; make room for more */
+            char *tmp = realloc(buf, cap * 2);
+
+            if (tmp == NULL) {
+                out_error("wgrep: out of memory\n");
+            }
+
+            buf = tmp;
+            cap *= 2;
+        }
+
+        ssize_t n = read(fd, buf + len, cap - len);
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+
+            /* what was read so far is out; don't pass the rest off as EOF */
+            out_error("wgrep: cannot open file\n");
+        }
+
+        size_t complete;
+
+        if (n == 0) {
+            /* the input may not end with a newline */
+            eof = true;
+            complete = len;
+        } else {
+            /* only search up to the last complete line of the new data */
+            char *last_nl = memrchr(buf + len, '\n', n);
+            len += n;
+
+            if (last_nl == NULL) continue;
+
+            complete = last_nl - buf + 1;
+        }
+
+        if (!search_buffer(buf, start, complete, ctx, opts, &state, &hits,
+                           max_lines - count)) {
+            out_error("wgrep: out of memory\n");
+        }
+
+        count += hits.count;
+
+        if (opts->quiet && count > 0) {
+            /* found what we were looking for */
+            exit(EXIT_SUCCESS);
+        }
+
+        if (!opts->count && !opts->list) {
+            write_hits(buf, STDIN_NAME, &hits, first_line, hits.count, opts, &pos);
+        }
+
+        first_line += hits.newlines;
+        clear_hits(&hits);
+
+        /* keep the unfinished line, and the lines before it -B may want */
+        size_t keep = complete;
+
+        for (size_t k = 0; k < opts->before && keep > state.floor; k++) {
+            char *nl = memrchr(buf + state.floor, '\n', keep - 1 - state.floor);
+            keep = (nl == NULL) ? state.floor : (size_t) (nl - buf + 1);
+        }
+
+        memmove(buf, buf + keep, len - keep);
+        len -= keep;
+        start = complete - keep;
+
+        /* everything below keep was written out or is no longer wanted */
+        state.floor = 0;
+
+        if (pos.valid && pos.end >= keep) {
+            pos.end -= keep;
+        } else {
+            pos.valid = false;
+        }
+    }
+
+    write_summary(opts, STDIN_NAME, count);
+    out_flush();
+
+    free_hits(&hits);
+    free(buf);
+    free_match_ctx(ctx);
+
+    /* getting this far with -q means nothing matched */
+    return opts->quiet ? EXIT_FAILURE : EXIT_SUCCESS;
+}
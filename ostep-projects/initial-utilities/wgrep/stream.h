@@ -0,0 +1,23 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "match.h"
+#include "options.h"
+
+/**
+ * Searches everything readable from fd (typically standard input) and writes
+ * the matching lines to stdout.
+ *
+ * Input is read in large blocks into a buffer that grows whenever a single
+ * line doesn't fit, so lines of any length are matched whole. Once a block
+ * is in, all of its complete lines are searched at once with the same
+ * whole-buffer search used for files; only the trailing partial line is
+ * moved back to the front of the buffer to wait for the next read.
+ *
+ * Reading stops as soon as the options are satisfied: after the -m limit,
+ * or on the first match for -l and -q. Returns the exit status for the
+ * program.
+ **/
+int search_stream(int fd, const matcher_t *matcher, const options_t *opts);
+
+#endif // STREAM_H_
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysinfo.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <dirent.h>
+
+#include "walk.h"
+#include "output.h"
+
+#define MAX_WALKERS 8           /* threads reading directories */
+#define DENTS_SIZE (32 << 10)   /* buffer for each getdents64() call */
+
+#define handle_error_en(en, msg)                \
+    do { errno = en; perror(msg); exit(EXIT_FAILURE); } while(0)
+
+/* what getdents64() fills its buffer with */
+struct linux_dirent64 {
+    ino64_t        d_ino;
+    off64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+typedef struct dir_node dir_node;
+
+/* an entry of a directory that is worth handing out */
+typedef struct {
+    char     *name;             /* the entry's name */
+    dir_node *dir;              /* the subdirectory, or NULL for a file */
+} entry_t;
+
+/* a directory found by the walk */
+struct dir_node {
+    char     *path;             /* path of the directory; NULL for the roots */
+    char     *name;             /* its name within the parent */
+    dir_node *parent;           /* the directory it was found in */
+    int      fd;                /* kept open until the subdirectories are */
+    size_t   unopened;          /* subdirectories still to be opened */
+    bool     listed;            /* the entries have been read */
+    bool     failed;            /* the directory couldn't be read */
+    entry_t  *entries;          /* regular files and subdirectories, by name */
+    size_t   num_entries;
+};
+
+struct walk_t {
+    pthread_mutex_t lock;
+    pthread_cond_t  listed;     /* signalled when a directory has been read */
+    pthread_cond_t  work;       /* signalled when there's something to read */
+
+    dir_node   **queue;         /* directories waiting to be read */
+    size_t     num_queued;
+    size_t     queue_cap;
+    size_t     busy;            /* walkers reading a directory right now */
+
+    pthread_t  *walkers;
+    int        num_walkers;
+
+    dir_node   top;             /* pseudo-directory holding the roots */
+    dir_node   **stack;         /* directories being handed out, outermost first */
+    size_t     *next;           /* next entry to hand out in each of them */
+    size_t     depth;
+    size_t     stack_cap;
+};
+
+
+static void *walker(void *);
+
+
+/* makes room for one more element of a growable array */
+static void *grow(void *array, size_t *cap, size_t num, size_t size) {
+    if (num < *cap) return array;
+
+    size_t new_cap = (*cap == 0) ? 16 : *cap * 2;
+    void *tmp = realloc(array, new_cap * size);
+
+    if (tmp == NULL) {
+        /* realloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    *cap = new_cap;
+    return tmp;
+}
+
+
+static char *join_path(const char *dir, const char *name) {
+    char *path;
+
+    if (dir == NULL) {
+        path = strdup(name);
+    } else {
+        size_t len = strlen(dir);
+        bool slash = (len > 0 && dir[len - 1] == '/');
+
+        path = malloc(len + strlen(name) + 2);
+        if (path != NULL) sprintf(path, slash ? "%s%s" : "%s/%s", dir, name);
+    }
+
+    if (path == NULL) {
+        /* malloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    return path;
+}
+
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const entry_t *) a)->name, ((const entry_t *) b)->name);
+}
+
+
+static dir_node *new_node(dir_node *parent, char *name) {
+    dir_node *node = calloc(1, sizeof(dir_node));
+
+    if (node == NULL) {
+        /* calloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    node->path = join_path(parent->path, name);
+    node->name = name;
+    node->parent = parent;
+    node->fd = -1;
+
+    return node;
+}
+
+
+static void free_node(dir_node *node) {
+    for (size_t i = 0; i < node->num_entries; i++) {
+        free(node->entries[i].name);
+    }
+
+    free(node->entries);
+    free(node->path);
+    free(node);
+}
+
+
+walk_t *walk_start(char **roots, size_t num_roots) {
+    walk_t *w = calloc(1, sizeof(walk_t));
+    struct stat statbuf;
+    int err;
+
+    if (w == NULL) {
+        /* calloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->listed, NULL);
+    pthread_cond_init(&w->work, NULL);
+
+    /* the roots are the entries of a directory that is already read */
+    w->top.fd = AT_FDCWD;
+    w->top.listed = true;
+    w->top.entries = calloc(num_roots + 1, sizeof(entry_t));
+
+    if (w->top.entries == NULL) {
+        /* calloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    for (size_t i = 0; i < num_roots; i++) {
+        entry_t *e = &w->top.entries[w->top.num_entries++];
+
+        e->name = join_path(NULL, roots[i]);
+
+        if (stat(roots[i], &statbuf) == 0 && S_ISDIR(statbuf.st_mode)) {
+            e->dir = new_node(&w->top, e->name);
+            w->top.unopened++;
+        }
+    }
+
+    /* queued last to first, so the first root is read first */
+    for (size_t i = num_roots; i-- > 0; ) {
+        if (w->top.entries[i].dir == NULL) continue;
+
+        w->queue = grow(w->queue, &w->queue_cap, w->num_queued, sizeof(dir_node *));
+        w->queue[w->num_queued++] = w->top.entries[i].dir;
+    }
+
+    w->stack = grow(w->stack, &w->stack_cap, 0, sizeof(dir_node *));
+    w->next = malloc(sizeof(size_t) * w->stack_cap);
+
+    if (w->next == NULL) {
+        /* malloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    w->stack[0] = &w->top;
+    w->next[0] = 0;
+    w->depth = 1;
+
+    w->num_walkers = get_nprocs();
+    if (w->num_walkers < 1) w->num_walkers = 1;
+    if (w->num_walkers > MAX_WALKERS) w->num_walkers = MAX_WALKERS;
+
+    w->walkers = calloc(w->num_walkers, sizeof(pthread_t));
+
+    if (w->walkers == NULL) {
+        /* calloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    for (int t = 0; t < w->num_walkers; t++) {
+        err = pthread_create(&w->walkers[t], NULL, &walker, w);
+        if (err != 0) {
+            handle_error_en(err, "pthread_create");
+        }
+    }
+
+    return w;
+}
+
+
+char *walk_next(walk_t *w) {
+    char *path = NULL;
+
+    pthread_mutex_lock(&w->lock);
+
+    while (w->depth > 0) {
+        dir_node *node = w->stack[w->depth - 1];
+
+        while (!node->listed) {
+            /* the walkers haven't got to this one yet */
+            pthread_cond_wait(&w->listed, &w->lock);
+        }
+
+        if (node->failed) {
+            /* hand out the directory itself, so that opening it fails */
+            path = node->path;
+            node->path = NULL;
+            free_node(node);
+            w->depth--;
+            break;
+        }
+
+        size_t *next = &w->next[w->depth - 1];
+
+        if (*next == node->num_entries) {
+            /* all of its entries have been handed out */
+            if (node != &w->top) free_node(node);
+            w->depth--;
+            continue;
+        }
+
+        entry_t *e = &node->entries[(*next)++];
+
+        if (e->dir != NULL) {
+            /* descend into the subdirectory */
+            size_t cap = w->stack_cap;
+
+            w->stack = grow(w->stack, &w->stack_cap, w->depth, sizeof(dir_node *));
+
+            if (cap != w->stack_cap) {
+                size_t *tmp = realloc(w->next, sizeof(size_t) * w->stack_cap);
+
+                if (tmp == NULL) {
+                    /* realloc failed */
+                    out_error("wgrep: out of memory\n");
+                }
+
+                w->next = tmp;
+            }
+
+            w->stack[w->depth] = e->dir;
+            w->next[w->depth] = 0;
+            w->depth++;
+            continue;
+        }
+
+        path = join_path(node->path, e->name);
+        break;
+    }
+
+    pthread_mutex_unlock(&w->lock);
+    return path;
+}
+
+
+void walk_free(walk_t *w) {
+    int err;
+
+    for (int t = 0; t < w->num_walkers; t++) {
+        err = pthread_join(w->walkers[t], NULL);
+        if (err != 0) {
+            handle_error_en(err, "pthread_join");
+        }
+    }
+
+    /* everything but the roots was freed as it was handed out */
+    for (size_t i = 0; i < w->top.num_entries; i++) {
+        free(w->top.entries[i].name);
+    }
+
+    free(w->top.entries);
+    free(w->queue);
+    free(w->stack);
+    free(w->next);
+    free(w->walkers);
+
+    pthread_cond_destroy(&w->work);
+    pthread_cond_destroy(&w->listed);
+    pthread_mutex_destroy(&w->lock);
+
+    free(w);
+}
+
+
+/* notes that a subdirectory opened itself; must be called with the lock held */
+static void opened_child(dir_node *parent) {
+    if (--parent->unopened == 0 && parent->fd != AT_FDCWD) {
+        close(parent->fd);
+        parent->fd = -1;
+    }
+}
+
+
+/* reads the directory's entries; runs without the lock held */
+static void read_dir(walk_t *w, dir_node *node, char *buf) {
+    size_t cap = 0;
+    size_t num_dirs = 0;
+    struct stat statbuf;
+    long n;
+
+    int fd = openat(node->parent->fd, node->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    pthread_mutex_lock(&w->lock);
+    opened_child(node->parent);
+    pthread_mutex_unlock(&w->lock);
+
+    if (fd == -1) {
+        node->failed = true;
+        return;
+    }
+
+    while ((n = syscall(SYS_getdents64, fd, buf, DENTS_SIZE)) > 0) {
+        for (long off = 0; off < n; ) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *) (buf + off);
+            unsigned char type = d->d_type;
+
+            off += d->d_reclen;
+
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+
+            if (type == DT_UNKNOWN) {
+                /* some file systems don't fill the type in */
+                if (fstatat(fd, d->d_name, &statbuf, AT_SYMLINK_NOFOLLOW) == -1) continue;
+
+                if (S_ISREG(statbuf.st_mode)) type = DT_REG;
+                if (S_ISDIR(statbuf.st_mode)) type = DT_DIR;
+            }
+
+            /* links and special files are left alone */
+            if (type != DT_REG && type != DT_DIR) continue;
+
+            node->entries = grow(node->entries, &cap, node->num_entries, sizeof(entry_t));
+
+            entry_t *e = &node->entries[node->num_entries++];
+            e->name = strdup(d->d_name);
+            e->dir = (type == DT_DIR) ? node : NULL;   /* filled in below */
+
+            if (e->name == NULL) {
+                /* strdup failed */
+                out_error("wgrep: out of memory\n");
+            }
+        }
+    }
+
+    if (n == -1) {
+        /* whatever was read can't be trusted to be the whole listing */
+        node->failed = true;
+        close(fd);
+        return;
+    }
+
+    if (node->num_entries > 1) {
+        qsort(node->entries, node->num_entries, sizeof(entry_t), compare_entries);
+    }
+
+    for (size_t i = 0; i < node->num_entries; i++) {
+        entry_t *e = &node->entries[i];
+
+        if (e->dir != NULL) {
+            e->dir = new_node(node, e->name);
+            num_dirs++;
+        }
+    }
+
+    pthread_mutex_lock(&w->lock);
+
+    node->fd = fd;
+    node->unopened = num_dirs;
+    if (num_dirs == 0) close(fd);
+
+    /* queued last to first, so that the walk reads ahead in output order */
+    for (size_t i = node->num_entries; i-- > 0; ) {
+        if (node->entries[i].dir == NULL) continue;
+
+        w->queue = grow(w->queue, &w->queue_cap, w->num_queued, sizeof(dir_node *));
+        w->queue[w->num_queued++] = node->entries[i].dir;
+    }
+
+    pthread_mutex_unlock(&w->lock);
+}
+
+
+static void *walker(void *arg) {
+    walk_t *w = arg;
+    char *buf = malloc(DENTS_SIZE);
+
+    if (buf == NULL) {
+        /* malloc failed */
+        out_error("wgrep: out of memory\n");
+    }
+
+    pthread_mutex_lock(&w->lock);
+
+    while (true) {
+        while (w->num_queued == 0 && w->busy > 0) {
+            /* another walker may still find more directories */
+            pthread_cond_wait(&w->work, &w->lock);
+        }
+
+        if (w->num_queued == 0) {
+            /* nothing queued and nobody reading: the walk is over */
+            break;
+        }
+
+        dir_node *node = w->queue[--w->num_queued];
+        w->busy++;
+
+        pthread_mutex_unlock(&w->lock);
+        read_dir(w, node, buf);
+        pthread_mutex_lock(&w->lock);
+
+        w->busy--;
+        node->listed = true;
+
+        pthread_cond_broadcast(&w->listed);
+        pthread_cond_broadcast(&w->work);
+    }
+
+    pthread_cond_broadcast(&w->work);
+    pthread_mutex_unlock(&w->lock);
+
+    free(buf);
+    return NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef WALK_H_
+#define WALK_H_
+
+#include <stddef.h>
+
+/**
+ * Walks directory trees with a few threads of its own, handing out the
+ * paths of the regular files found in a fixed order: the roots in the order
+ * given, and the entries of every directory sorted by name, depth first.
+ *
+ * Directories are read with openat() relative to their parent's descriptor
+ * and getdents64(), as soon as they are found and in any order, so the
+ * listing runs ahead of whoever is taking paths out. Taking a path out only
+ * waits when the directory it lives in hasn't been read yet.
+ *
+ * Symbolic links and special files inside the trees are skipped. A root
+ * that isn't a directory is handed out as it is, and so is a directory that
+ * can't be read, so that opening it reports the error.
+ **/
+typedef struct walk_t walk_t;
+
+/* starts walking the given roots */
+walk_t *walk_start(char **roots, size_t num_roots);
+
+/**
+ * Returns the path of the next file (which the caller must free), or NULL
+ * once every tree has been walked.
+ **/
+char *walk_next(walk_t*);
+
+/* waits for the walking threads and frees what's left of the walk */
+void walk_free(walk_t*);
+
+#endif // WALK_H_
@@ -1,50 +1,217 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <getopt.h>
 
-int main(int argc, char *argv[]) {
-    if (argc <= 1) {
-        printf("wgrep: searchterm [file ...]\n");
+#include "index.h"
+#include "match.h"
+#include "options.h"
+#include "pool.h"
+#include "stream.h"
+#include "zsearch.h"
+
+#define USAGE "wgrep: searchterm [file ...]\n"
+
+#define OPT_INDEX 256           /* --index, which has no short form */
+
+static const struct option long_opts[] = {
+    { "index", required_argument, NULL, OPT_INDEX },
+    { NULL, 0, NULL, 0 }
+};
+
+/* parses the count given to -m, -A, -B or -C, or exits with the usage */
+static size_t parse_count(const char *arg) {
+    char *end;
+    size_t n = strtoull(arg, &end, 10);
+
+    if (*arg == '\0' || *arg == '-' || *end != '\0') {
+        printf(USAGE);
         exit(EXIT_FAILURE);
     }
 
-    char *query = argv[1];
+    return n;
+}
+
+
+int main(int argc, char *argv[]) {
+    char *pattern_file = NULL;
+    char *regex = NULL;
+    char *index_dir = NULL;
+    bool compressed = false;
+    bool icase = false;
+    options_t opts = { false, false, false, SIZE_MAX, false, false, false, 0, 0, false, false };
+    int opt;
+
+    /* a bad option gets wgrep's own usage line, not getopt's message */
+    opterr = 0;
+
+    while ((opt = getopt_long(argc, argv, "E:f:iclqm:nA:B:C:zr", long_opts, NULL)) != -1) {
+        switch (opt) {
+            case 'E':
+                /* search for a regular expression instead of a string */
+                regex = optarg;
+                break;
+
+            case 'f':
+                /* search for every line of the file at once */
+                pattern_file = optarg;
+                break;
+
+            case 'i':
+                /* ignore the case of ASCII letters */
+                icase = true;
+                break;
+
+            case 'c':
+                /* count matching lines instead of printing them */
+                opts.count = true;
+                break;
+
+            case 'l':
+                /* only print the names of files with a match */
+                opts.list = true;
+                break;
+
+            case 'q':
+                /* print nothing; the exit status says if anything matched */
+                opts.quiet = true;
+                break;
+
+            case 'm':
+                /* stop reading a file after this many matching lines */
+                opts.max_count = parse_count(optarg);
+                break;
+
+            case 'n':
+                /* prefix lines with their line numbers */
+                opts.line_numbers = true;
+                break;
+
+            case 'A':
+                /* also print lines after each match */
+                opts.after = parse_count(optarg);
+                opts.context = true;
+                break;
+
+            case 'B':
+                /* also print lines before each match */
+                opts.before = parse_count(optarg);
+                opts.context = true;
+                break;
+
+            case 'C':
+                /* also print lines on both sides of each match */
+                opts.before = opts.after = parse_count(optarg);
+                opts.context = true;
+                break;
+
+            case 'z':
+                /* the input was compressed by wzip or pzip */
+                compressed = true;
+                break;
 
-    if (argc == 2) {
-        const size_t BUFFER_LENGTH = 256;
-        char buffer[BUFFER_LENGTH];
+            case 'r':
+                /* search whole directory trees */
+                opts.recursive = true;
+                break;
 
-        while (fgets(buffer, BUFFER_LENGTH, stdin)) {
-            if (strstr(buffer, query) != NULL) {
-                printf("%s", buffer);
-            }
+            case OPT_INDEX:
+                /* search a directory through its trigram index */
+                index_dir = optarg;
+                break;
+
+            default:
+                printf(USAGE);
+                exit(EXIT_FAILURE);
         }
+    }
+
+    if (opts.count || opts.list || opts.quiet) {
+        /* no lines get printed, so there's nothing to number or surround */
+        opts.line_numbers = false;
+        opts.before = opts.after = 0;
+        opts.context = false;
+    }
+
+    if (index_dir != NULL && regex == NULL && pattern_file == NULL && optind == argc) {
+        /* nothing to search for; just bring the index up to date */
+        update_index(index_dir);
         exit(EXIT_SUCCESS);
     }
 
-    for(int i = 2; i < argc; i++) {
-        FILE *fp = fopen(argv[i], "r");
-        if (fp == NULL) {
+    matcher_t *matcher;
+
+    if (regex != NULL) {
+        matcher = matcher_regex(regex, icase);
+
+        if (matcher == NULL) {
+            printf("wgrep: invalid regular expression\n");
+            exit(EXIT_FAILURE);
+        }
+    } else if (pattern_file != NULL) {
+        matcher = matcher_from_file(pattern_file, icase);
+
+        if (matcher == NULL) {
             printf("wgrep: cannot open file\n");
             exit(EXIT_FAILURE);
         }
+    } else {
+        if (optind >= argc) {
+            printf(USAGE);
+            exit(EXIT_FAILURE);
+        }
 
-        size_t n = 0;
-        char *lineptr = NULL;
+        matcher = matcher_literal(argv[optind++], icase);
 
-        while (getline(&lineptr, &n, fp) != -1) {
-            if (strstr(lineptr, query) != NULL) {
-                printf("%s", lineptr);
-            }
+        if (matcher == NULL) {
+            printf("wgrep: out of memory\n");
+            exit(EXIT_FAILURE);
         }
+    }
 
-        free(lineptr);
+    int status;
+
+    if (compressed) {
+        /* runs are matched as they are, which only works for a single string */
+        if (matcher->kind != MATCH_LITERAL || matcher->icase || index_dir != NULL) {
+            printf("wgrep: -z only searches for a single string\n");
+            exit(EXIT_FAILURE);
+        }
 
-        if (fclose(fp)) {
-            printf("wgrep: could not close file properly\n");
+        if (opts.before > 0 || opts.after > 0) {
+            printf("wgrep: -z does not print context lines\n");
             exit(EXIT_FAILURE);
         }
+
+        opts.with_names = (argc - optind > 1);
+        status = search_compressed(&argv[optind], argc - optind, matcher, &opts);
+    } else if (index_dir != NULL) {
+        /* the index decides which files (and which parts of them) to read */
+        if (optind != argc) {
+            printf(USAGE);
+            exit(EXIT_FAILURE);
+        }
+
+        opts.with_names = opts.name_lines = true;
+        status = search_index(index_dir, matcher, &opts);
+    } else if (opts.recursive) {
+        /* with no directory given, search the current one */
+        char *here[] = { "." };
+        bool given = (optind < argc);
+
+        opts.with_names = opts.name_lines = true;
+        status = search_files(given ? &argv[optind] : here, given ? argc - optind : 1,
+                              matcher, &opts);
+    } else if (optind == argc) {
+        /* no files given; search standard input */
+        status = search_stream(STDIN_FILENO, matcher, &opts);
+    } else {
+        /* files are searched in parallel, but written out in the order given */
+        opts.with_names = (argc - optind > 1);
+        status = search_files(&argv[optind], argc - optind, matcher, &opts);
     }
 
-    exit(EXIT_SUCCESS);
+    free_matcher(matcher);
+    exit(status);
 }
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "zsearch.h"
+#include "output.h"
+
+#define RECORD_SIZE 5           /* a 4 byte run length, then the character */
+#define READ_SIZE (64 << 10)    /* read size for input that can't be mapped */
+#define EXPAND_SIZE 4096        /* bytes of a long run expanded at a time */
+
+/* a sequence of runs, with neighbours of the same character merged */
+typedef struct {
+    unsigned char *chars;       /* the character of every run */
+    uint64_t      *counts;      /* and how many times it repeats */
+    size_t        num;          /* number of runs */
+} runs_t;
+
+
+static void free_runs(runs_t *r) {
+    free(r->chars);
+    free(r->counts);
+    r->chars = NULL;
+    r->counts = NULL;
+    r->num = 0;
+}
+
+
+/* appends a run, extending the previous one if it has the same character */
+static void add_run(runs_t *r, unsigned char c, uint64_t count) {
+    if (count == 0) return;
+
+    if (r->num > 0 && r->chars[r->num - 1] == c) {
+        r->counts[r->num - 1] += count;
+        return;
+    }
+
+    r->chars[r->num] = c;
+    r->counts[r->num] = count;
+    r->num++;
+}
+
+
+/* makes room for up to len runs */
+static bool alloc_runs(runs_t *r, size_t len) {
+    r->num = 0;
+    r->chars = malloc(len + 1);
+    r->counts = malloc(sizeof(uint64_t) * (len + 1));
+
+    if (r->chars == NULL || r->counts == NULL) {
+        /* malloc failed */
+        free_runs(r);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Turns the compressed records into runs. Records of the same character are
+ * merged, as pzip may split a run where its chunks meet, and empty records
+ * (wzip writes one for an empty input) are dropped. Returns false if the
+ * data isn't a whole number of records.
+ **/
+static bool parse_records(const char *data, size_t size, runs_t *r) {
+    if (size % RECORD_SIZE != 0) return false;
+
+    if (!alloc_runs(r, size / RECORD_SIZE)) {
+        out_error("wgrep: out of memory\n");
+    }
+
+    for (size_t off = 0; off < size; off += RECORD_SIZE) {
+        int32_t count;
+
+        memcpy(&count, data + off, sizeof(count));
+        if (count > 0) add_run(r, data[off + 4], count);
+    }
+
+    return true;
+}
+
+
+/* reads the whole of fd, mapping it when possible */
+static char *load_input(int fd, size_t *size, bool *mapped) {
+    struct stat statbuf;
+    char *data = NULL;
+    size_t cap = 0;
+    ssize_t n;
+
+    *size = 0;
+    *mapped = false;
+
+    if (fstat(fd, &statbuf) == -1) return NULL;
+
+    if (S_ISREG(statbuf.st_mode) && statbuf.st_size > 0) {
+        data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data != MAP_FAILED) {
+            *size = statbuf.st_size;
+            *mapped = true;
+            madvise(data, *size, MADV_SEQUENTIAL);
+            return data;
+        }
+
+        data = NULL;
+    }
+
+    do {
+        if (*size == cap) {
+            char *tmp = realloc(data, cap + READ_SIZE);
+
+            if (tmp == NULL) {
+                /* realloc failed */
+                free(data);
+                return NULL;
+            }
+
+            data = tmp;
+            cap += READ_SIZE;
+        }
+
+        n = read(fd, data + *size, cap - *size);
+        if (n > 0) *size += n;
+    } while (n > 0 || (n == -1 && errno == EINTR));
+
+    return data;
+}
+
+
+/**
+ * Checks for the pattern's runs starting at the file's run i. The first
+ * pattern run may be the tail of a longer file run, and the last one the
+ * head of a longer run; everything between must be identical.
+ **/
+static bool match_at(const runs_t *f, size_t i, const runs_t *p) {
+    size_t last = p->num - 1;
+
+    if (f->chars[i] != p->chars[0] || f->counts[i] < p->counts[0]) return false;
+
+    if (last == 0) return true;
+
+    if (f->num - i <= last) return false;
+
+    for (size_t k = 1; k < last; k++) {
+        if (f->chars[i + k] != p->chars[k] || f->counts[i + k] != p->counts[k]) {
+            return false;
+        }
+    }
+
+    return f->chars[i + last] == p->chars[last] && f->counts[i + last] >= p->counts[last];
+}
+
+
+/* expands the runs [from, to) of a matching line, and the newline after it */
+static void write_line(const runs_t *f, size_t from, size_t to, const char *name,
+                       uint64_t lineno, const options_t *opts) {
+    char buf[EXPAND_SIZE];
+
+    if (opts->name_lines) {
+        out_write(name, strlen(name));
+        out_write(":", 1);
+    }
+
+    if (opts->line_numbers) {
+        int len = snprintf(buf, sizeof(buf), "%lu:", (unsigned long) lineno);
+        out_write(buf, len);
+    }
+
+    for (size_t k = from; k < to; k++) {
+        uint64_t left = f->counts[k];
+
+        memset(buf, f->chars[k], (left < EXPAND_SIZE) ? left : EXPAND_SIZE);
+
+        while (left > 0) {
+            size_t n = (left < EXPAND_SIZE) ? left : EXPAND_SIZE;
+            out_write(buf, n);
+            left -= n;
+        }
+    }
+
+    if (to < f->num) out_write("\n", 1);
+}
+
+
+/* searches the runs line by line; returns the number of matching lines */
+static size_t search_runs(const runs_t *f, const char *name, const runs_t *p, bool possible,
+                          const options_t *opts, size_t max_lines) {
+    bool print = !opts->count && !opts->list && !opts->quiet;
+    bool every_line = (p->num == 0);
+    uint64_t lineno = 1;
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i < f->num && count < max_lines) {
+        /* a line is every run up to the next newline run */
+        size_t j = i;
+        bool hit = every_line;
+
+        for (; j < f->num && f->chars[j] != '\n'; j++) {
+            if (!hit && possible && match_at(f, j, p)) hit = true;
+        }
+
+        if (hit) {
+            count++;
+
+            if (opts->quiet) {
+                /* found what we were looking for */
+                exit(EXIT_SUCCESS);
+            }
+
+            if (print) write_line(f, i, j, name, lineno, opts);
+        }
+
+        if (j == f->num) break;
+
+        /* the first newline ends the line; any others are empty lines */
+        uint64_t empty = f->counts[j] - 1;
+
+        for (uint64_t k = 0; every_line && k < empty && count < max_lines; k++) {
+            count++;
+            if (print) write_line(f, j, j, name, lineno + 1 + k, opts);
+        }
+
+        lineno += 1 + empty;
+        i = j + 1;
+    }
+
+    return count;
+}
+
+
+/* searches one compressed input, and writes its summary */
+static void search_input(int fd, const char *name, const runs_t *p, bool possible,
+                         const options_t *opts) {
+    size_t size;
+    bool mapped;
+    runs_t runs;
+    char *data = load_input(fd, &size, &mapped);
+
+    if (data == NULL) {
+        out_error("wgrep: cannot open file\n");
+    }
+
+    bool ok = parse_records(data, size, &runs);
+
+    if (mapped) {
+        munmap(data, size);
+    } else {
+        free(data);
+    }
+
+    if (!ok) {
+        out_error("wgrep: not a compressed file\n");
+    }
+
+    /* for -l and -q, one match answers the question */
+    size_t max_lines = (opts->list || opts->quiet) ? 1 : opts->max_count;
+    size_t count = search_runs(&runs, name, p, possible, opts, max_lines);
+
+    write_summary(opts, name, count);
+    free_runs(&runs);
+}
+
+
+int search_compressed(char **files, size_t num_files, const matcher_t *matcher,
+                      const options_t *opts) {
+    runs_t pattern;
+
+    if (!alloc_runs(&pattern, matcher->literal_len)) {
+        out_error("wgrep: out of memory\n");
+    }
+
+    for (size_t i = 0; i < matcher->literal_len; i++) {
+        add_run(&pattern, matcher->literal[i], 1);
+    }
+
+    /* a newline run would let a match span lines */
+    bool possible = memchr(matcher->literal, '\n', matcher->literal_len) == NULL;
+
+    if (num_files == 0) {
+        search_input(STDIN_FILENO, STDIN_NAME, &pattern, possible, opts);
+    }
+
+    for (size_t i = 0; i < num_files; i++) {
+        int fd = open(files[i], O_RDONLY);
+
+        if (fd == -1) {
+            out_error("wgrep: cannot open file\n");
+        }
+
+        search_input(fd, files[i], &pattern, possible, opts);
+        close(fd);
+    }
+
+    out_flush();
+    free_runs(&pattern);
+
+    /* getting this far with -q means nothing matched */
+    return opts->quiet ? EXIT_FAILURE : EXIT_SUCCESS;
+}
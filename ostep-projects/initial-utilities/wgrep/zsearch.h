@@ -0,0 +1,26 @@
+#ifndef ZSEARCH_H_
+#define ZSEARCH_H_
+
+#include <stddef.h>
+
+#include "match.h"
+#include "options.h"
+
+/**
+ * Searches files compressed by wzip or pzip (a sequence of records, each a
+ * 4 byte run length followed by the repeated character) for a literal
+ * string, without decompressing them.
+ *
+ * The pattern is turned into runs of its own. Its inner runs must match the
+ * file's runs exactly, while its first and last runs only need a run of the
+ * same character at least as long. Newline runs mark the line boundaries, so
+ * line numbers come from summing their lengths, and only the lines that
+ * match are ever expanded.
+ *
+ * With no files, the compressed data is read from standard input. Returns
+ * the exit status for the program.
+ **/
+int search_compressed(char **files, size_t num_files, const matcher_t *matcher,
+                      const options_t *opts);
+
+#endif // ZSEARCH_H_
@@ -0,0 +1,10 @@
+#! /bin/bash
+
+if ! [[ -x wzcat ]]; then
+    echo "wzcat executable does not exist"
+    exit 1
+fi
+
+../../tester/run-tests.sh $*
+
+
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define RECORD_SIZE 5               /* a 4 byte run length, then the character */
+#define MAX_RUN INT32_MAX           /* longest run a single record can hold */
+#define BUFFER_SIZE (128 << 10)     /* read()/write() size for the fallback */
+
+/* a single record of the wzip format */
+typedef struct {
+    int32_t       count;        /* number of times the character repeats */
+    unsigned char c;            /* the character */
+} record_t;
+
+/* how the data gets from a file to standard output */
+typedef enum {
+    COPY_RANGE,     /* copy_file_range(): file to file, possibly just extents */
+    COPY_SPLICE,    /* splice(): a file into a pipe, through its pages */
+    COPY_SENDFILE,  /* sendfile(): a file's page cache to a socket or file */
+    COPY_BUFFER     /* pread() and write() through a buffer of our own */
+} method_t;
+
+static method_t method;
+
+
+static void fail(const char *msg) {
+    printf("%s", msg);
+    exit(EXIT_FAILURE);
+}
+
+
+static void write_all(const void *buf, size_t len) {
+    for (size_t done = 0; done < len; ) {
+        ssize_t n = write(STDOUT_FILENO, (const char *) buf + done, len - done);
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            fail("wzcat: cannot write file\n");
+        }
+
+        done += n;
+    }
+}
+
+
+static void write_record(record_t r) {
+    unsigned char buf[RECORD_SIZE];
+
+    memcpy(buf, &r.count, sizeof(r.count));
+    buf[4] = r.c;
+    write_all(buf, RECORD_SIZE);
+}
+
+
+static record_t read_record(int fd, off_t off) {
+    unsigned char buf[RECORD_SIZE];
+    record_t r;
+
+    if (pread(fd, buf, RECORD_SIZE, off) != RECORD_SIZE) {
+        fail("wzcat: cannot read file\n");
+    }
+
+    memcpy(&r.count, buf, sizeof(r.count));
+    r.c = buf[4];
+    return r;
+}
+
+
+/* copies len bytes of fd from off through a buffer */
+static void copy_buffer(int fd, off_t off, size_t len) {
+    static char buffer[BUFFER_SIZE];
+
+    while (len > 0) {
+        ssize_t n = pread(fd, buffer, (len < BUFFER_SIZE) ? len : BUFFER_SIZE, off);
+
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) fail("wzcat: cannot read file\n");
+
+        write_all(buffer, n);
+        off += n;
+        len -= n;
+    }
+}
+
+
+/**
+ * Copies len bytes of fd from off to stdout without them passing through
+ * user space, as wcat does. Falls back to copy_buffer() for the rest if the
+ * kernel turns out not to support the method for these descriptors.
+ **/
+static void copy_range(int fd, off_t off, size_t len) {
+    while (len > 0 && method != COPY_BUFFER) {
+        ssize_t n;
+
+        switch (method) {
+            case COPY_RANGE:
+                n = copy_file_range(fd, &off, STDOUT_FILENO, NULL, len, 0);
+                break;
+
+            case COPY_SPLICE:
+                n = splice(fd, &off, STDOUT_FILENO, NULL, len, SPLICE_F_MOVE);
+                break;
+
+            default:
+                n = sendfile(STDOUT_FILENO, fd, &off, len);
+                break;
+        }
+
+        if (n == -1 && errno == EINTR) continue;
+
+        if (n == -1 && (errno == EINVAL || errno == EXDEV || errno == ENOSYS ||
+                        errno == EOPNOTSUPP || errno == EBADF)) {
+            /* unsupported for these files; the offset is where it stopped */
+            method = COPY_BUFFER;
+            break;
+        }
+
+        if (n == -1) fail("wzcat: cannot write file\n");
+        if (n == 0) fail("wzcat: cannot read file\n");
+
+        len -= n;
+    }
+
+    copy_buffer(fd, off, len);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc <= 1) {
+        printf("wzcat: file1 [file2 ...]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat out_stat;
+
+    if (fstat(STDOUT_FILENO, &out_stat) == -1) {
+        method = COPY_BUFFER;
+    } else if (S_ISREG(out_stat.st_mode)) {
+        method = COPY_RANGE;
+    } else if (S_ISFIFO(out_stat.st_mode)) {
+        method = COPY_SPLICE;
+    } else {
+        method = COPY_SENDFILE;
+    }
+
+    /* the last record so far, held back in case the next file continues it */
+    record_t last;
+    bool have_last = false;
+
+    for (int i = 1; i < argc; i++) {
+        int fd = open(argv[i], O_RDONLY);
+        struct stat st;
+
+        if (fd == -1 || fstat(fd, &st) == -1) {
+            fail("wzcat: cannot open file\n");
+        }
+
+        if (!S_ISREG(st.st_mode) || st.st_size % RECORD_SIZE != 0) {
+            fail("wzcat: not a compressed file\n");
+        }
+
+        off_t size = st.st_size;
+        off_t from = 0;
+
+        record_t first = (size > 0) ? read_record(fd, 0) : (record_t) { 0, 0 };
+
+        /* wzip writes a single empty record for empty input */
+        if (size == 0 || (size == RECORD_SIZE && first.count == 0)) {
+            close(fd);
+            continue;
+        }
+
+        if (have_last && last.c == first.c && (int64_t) last.count + first.count <= MAX_RUN) {
+            /* the run goes on across the boundary; write it as one record */
+            first.count += last.count;
+            from = RECORD_SIZE;
+
+            if (size == RECORD_SIZE) {
+                /* the whole file was that run, and the next may continue it */
+                last = first;
+                close(fd);
+                continue;
+            }
+
+            write_record(first);
+        } else if (have_last) {
+            write_record(last);
+        }
+
+        /* everything but the first record (if merged) and the last goes as is */
+        last = read_record(fd, size - RECORD_SIZE);
+        have_last = true;
+        copy_range(fd, from, size - RECORD_SIZE - from);
+
+        close(fd);
+    }
+
+    /* nothing but empty input still makes an empty record, as wzip does */
+    write_record(have_last ? last : (record_t) { 0, 0 });
+
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,142 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define READ_SIZE (1 << 20)         /* bytes read from a file at a time */
+#define OUT_SIZE (256 << 10)        /* bytes of records written at a time */
+#define RECORD_SIZE 5               /* a 4 byte run length, then the character */
+#define MAX_RUN INT32_MAX           /* longest run a single record can hold */
+
+/* the run being counted, which may go on into the next block or file */
+typedef struct {
+    unsigned char c;            /* character */
+    uint64_t      count;        /* times it has repeated so far; 0 before any input */
+} run_t;
+
+static unsigned char output[OUT_SIZE];
+static size_t output_len;
+
+
+static void flush_output(void) {
+    for (size_t done = 0; done < output_len; ) {
+        ssize_t n = write(STDOUT_FILENO, output + done, output_len - done);
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            exit(EXIT_FAILURE);
+        }
+
+        done += n;
+    }
+
+    output_len = 0;
+}
+
+
+/* writes out what has been compressed so far, then the message, and exits */
+static void fail(const char *msg) {
+    flush_output();
+    printf("%s", msg);
+    exit(EXIT_FAILURE);
+}
+
+
+static inline void put_record(unsigned char c, int32_t count) {
+    if (OUT_SIZE - output_len < RECORD_SIZE) flush_output();
+
+    memcpy(output + output_len, &count, sizeof(count));
+    output[output_len + 4] = c;
+    output_len += RECORD_SIZE;
+}
+
+
+/* packs a run into records, splitting it if one record can't hold it all */
+static inline void put_run(unsigned char c, uint64_t count) {
+    for (; count > MAX_RUN; count -= MAX_RUN) {
+        put_record(c, MAX_RUN);
+    }
+
+    put_record(c, count);
+}
+
+
+/**
+ * Adds a block of input to the current run, writing out every run that
+ * ends inside the block. Rather than scanning each run to its end, which
+ * costs a mispredicted branch for nearly every run of ordinary text, this
+ * compares the block with itself shifted by one byte, 16 bytes at a time:
+ * the bytes that differ from the one before them start new runs, and the
+ * distance between two of them is a run length. Once a block turns out to
+ * have no such bytes, the run is followed 64 bytes at a time.
+ **/
+static void compress(const unsigned char *buf, size_t len, run_t *run) {
+    if (len == 0) return;
+
+    /* where the current run started, relative to buf (at or before 0) */
+    int64_t start = -(int64_t) run->count;
+
+    if (run->count > 0 && buf[0] != run->c) {
+        put_run(run->c, run->count);
+        start = 0;
+    }
+
+    size_t i = 1;
+
+#ifdef __SSE2__
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) (buf + i));
+        __m128i before = _mm_loadu_si128((const __m128i *) (buf + i - 1));
+        unsigned mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(block, before)) & 0xFFFF;
+
+        if (mask == 0) {
+            /* inside a long run; look for its end 64 bytes at a time */
+            const __m128i c = _mm_set1_epi8(buf[i]);
+
+            for (; i + 16 + 64 <= len; i += 64) {
+                const __m128i *next = (const __m128i *) (buf + i + 16);
+                __m128i same = _mm_and_si128(
+                    _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(next), c),
+                                  _mm_cmpeq_epi8(_mm_loadu_si128(next + 1), c)),
+                    _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(next + 2), c),
+                                  _mm_cmpeq_epi8(_mm_loadu_si128(next + 3), c)));
+
+                if (_mm_movemask_epi8(same) != 0xFFFF) break;
+            }
+
+            continue;
+        }
+
+        while (mask != 0) {
+            size_t end = i + __builtin_ctz(mask);
+
+            put_run(buf[end - 1], end - start);
+            start = end;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    /* leftover tail (or the whole block without SSE2) */
+    for (; i < len; i++) {
+        if (buf[i] != buf[i - 1]) {
+            put_run(buf[i - 1], i - start);
+            start = i;
+        }
+    }
+
+    run->c = buf[len - 1];
+    run->count = len - start;
+}
+
 
 int main(int argc, char *argv[]) {
     if (argc <= 1) {
@@ -8,40 +144,35 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    int counter = 0;
-    char current, previous;
-    bool flag = true;
+    static unsigned char buffer[READ_SIZE];
+    run_t run = { 0, 0 };
 
     for (int i = 1; i < argc; i++) {
-        FILE *fp = fopen(argv[i], "r");
-        if (fp == NULL) {
-            printf("wzip: cannot open file\n");
-            exit(EXIT_FAILURE);
+        int fd = open(argv[i], O_RDONLY);
+        if (fd == -1) {
+            fail("wzip: cannot open file\n");
         }
 
-        while ((current = fgetc(fp)) != EOF) {
-            if (flag) {
-                previous = current;
-                flag = false;
-            }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        ssize_t n;
 
-            if (current == previous) {
-                counter++;
-                continue;
+        while ((n = read(fd, buffer, READ_SIZE)) != 0) {
+            if (n == -1) {
+                if (errno == EINTR) continue;
+                fail("wzip: cannot read file\n");
             }
 
-            fwrite(&counter, sizeof counter, 1, stdout);
-            fwrite(&previous, sizeof previous, 1, stdout);
-            previous = current;
-            counter = 1;
+            compress(buffer, n, &run);
         }
 
-        fclose(fp);
+        close(fd);
 
     }
 
-    fwrite(&counter, sizeof counter, 1, stdout);
-    fwrite(&previous, sizeof previous, 1, stdout);
+    /* the last run; with no input at all, an empty record as before */
+    put_run(run.c, run.count);
+    flush_output();
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,10 @@
+#! /bin/bash
+
+if ! [[ -x wzstat ]]; then
+    echo "wzstat executable does not exist"
+    exit 1
+fi
+
+../../tester/run-tests.sh $*
+
+
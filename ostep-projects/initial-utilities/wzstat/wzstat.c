@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define RECORD_SIZE 5               /* a 4 byte run length, then the character */
+#define MIN_SLICE (64 << 10)        /* fewest records worth a thread of their own */
+#define NUM_BUCKETS 64              /* run length buckets: 1, 2-3, 4-7, ... */
+
+/* a run of one character, possibly spread over several records */
+typedef struct {
+    unsigned char c;
+    uint64_t      len;
+} run_t;
+
+/* what is known about a stretch of records */
+typedef struct {
+    uint64_t bytes;                 /* uncompressed length */
+    uint64_t records;               /* records, empty ones included */
+    uint64_t hist[256];             /* uncompressed bytes of each value */
+    uint64_t runs;                  /* runs, with records of the same byte merged */
+    uint64_t buckets[NUM_BUCKETS];  /* runs by floor(log2(length)) */
+    run_t    longest;               /* the longest run */
+
+    /**
+     * The first and last runs of the stretch are left out of the numbers
+     * above, as they may go on into the stretches on either side. When the
+     * whole stretch is a single run, first and last are the same run.
+     **/
+    run_t    first;
+    run_t    last;
+    bool     single;
+} stats_t;
+
+/* a thread's share of the records */
+typedef struct {
+    pthread_t            thread;
+    const unsigned char *data;
+    size_t               num_records;
+    stats_t              stats;
+} slice_t;
+
+
+static void fail(const char *msg) {
+    printf("%s", msg);
+    exit(EXIT_FAILURE);
+}
+
+
+/* counts a run that is known to be whole */
+static void add_run(stats_t *s, run_t run) {
+    s->runs++;
+    s->buckets[63 - __builtin_clzll(run.len)]++;
+
+    if (run.len > s->longest.len) s->longest = run;
+}
+
+
+/* goes through a slice of records; empty records are ignored */
+static void *scan_slice(void *arg) {
+    slice_t *slice = arg;
+    stats_t *s = &slice->stats;
+    const unsigned char *p = slice->data;
+    run_t run = { 0, 0 };
+    bool first = true;
+
+    s->records = slice->num_records;
+
+    for (size_t i = 0; i < slice->num_records; i++, p += RECORD_SIZE) {
+        int32_t count;
+        unsigned char c = p[4];
+
+        memcpy(&count, p, sizeof(count));
+        if (count <= 0) continue;
+
+        s->bytes += count;
+        s->hist[c] += count;
+
+        if (run.len > 0 && c == run.c) {
+            run.len += count;
+            continue;
+        }
+
+        if (run.len > 0) {
+            /* a run ends; the first one of the slice is kept aside */
+            if (first) {
+                s->first = run;
+                first = false;
+            } else {
+                add_run(s, run);
+            }
+        }
+
+        run.c = c;
+        run.len = count;
+    }
+
+    if (first) {
+        /* one run at most */
+        s->first = run;
+        s->single = true;
+    }
+
+    s->last = run;
+    return NULL;
+}
+
+
+/* adds up the slices, in order, joining runs that cross from one to the next */
+static void merge_slices(slice_t *slices, int num, stats_t *total) {
+    run_t open = { 0, 0 };          /* the run that may still go on */
+
+    memset(total, 0, sizeof(*total));
+
+    for (int i = 0; i < num; i++) {
+        stats_t *s = &slices[i].stats;
+
+        total->bytes += s->bytes;
+        total->records += s->records;
+        total->runs += s->runs;
+
+        for (int b = 0; b < 256; b++) total->hist[b] += s->hist[b];
+        for (int b = 0; b < NUM_BUCKETS; b++) total->buckets[b] += s->buckets[b];
+
+        if (s->longest.len > total->longest.len) total->longest = s->longest;
+
+        if (s->first.len == 0) continue;    /* nothing but empty records */
+
+        if (open.len > 0 && open.c == s->first.c) {
+            open.len += s->first.len;
+        } else {
+            if (open.len > 0) add_run(total, open);
+            open = s->first;
+        }
+
+        if (!s->single) {
+            add_run(total, open);
+            open = s->last;
+        }
+    }
+
+    if (open.len > 0) add_run(total, open);
+}
+
+
+/* a byte as it is printed: quoted if printable, in hex otherwise */
+static const char *byte_name(unsigned char c, char name[8]) {
+    if (c == '\n') {
+        strcpy(name, "'\\n'");
+    } else if (c == '\t') {
+        strcpy(name, "'\\t'");
+    } else if (isprint(c)) {
+        snprintf(name, 8, "'%c'", c);
+    } else {
+        snprintf(name, 8, "0x%02x", c);
+    }
+
+    return name;
+}
+
+
+static void print_stats(const stats_t *s) {
+    char name[8];
+
+    printf("uncompressed bytes: %lu\n", (unsigned long) s->bytes);
+    printf("records:            %lu\n", (unsigned long) s->records);
+    printf("runs:               %lu\n", (unsigned long) s->runs);
+
+    if (s->runs > 0) {
+        printf("longest run:        %lu x %s\n", (unsigned long) s->longest.len,
+               byte_name(s->longest.c, name));
+    }
+
+    printf("run lengths:\n");
+
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        if (s->buckets[b] == 0) continue;
+
+        uint64_t low = (uint64_t) 1 << b;
+        uint64_t high = low + (low - 1);
+        char range[48];
+
+        snprintf(range, sizeof(range), (low == high) ? "%lu" : "%lu-%lu",
+                 (unsigned long) low, (unsigned long) high);
+        printf("  %-24s %lu\n", range, (unsigned long) s->buckets[b]);
+    }
+
+    printf("bytes:\n");
+
+    for (int c = 0; c < 256; c++) {
+        if (s->hist[c] == 0) continue;
+
+        printf("  %-4s  %lu\n", byte_name(c, name), (unsigned long) s->hist[c]);
+    }
+}
+
+
+/* maps a compressed file and works out its stats, a slice per thread */
+static void stat_file(const char *name, stats_t *total) {
+    struct stat statbuf;
+    int fd = open(name, O_RDONLY);
+
+    if (fd == -1 || fstat(fd, &statbuf) == -1) {
+        fail("wzstat: cannot open file\n");
+    }
+
+    if (!S_ISREG(statbuf.st_mode) || statbuf.st_size % RECORD_SIZE != 0) {
+        fail("wzstat: not a compressed file\n");
+    }
+
+    size_t num_records = statbuf.st_size / RECORD_SIZE;
+    const unsigned char *data = NULL;
+
+    if (num_records > 0) {
+        data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (data == MAP_FAILED) {
+            fail("wzstat: cannot read file\n");
+        }
+
+        madvise((void *) data, statbuf.st_size, MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+
+    /* number of threads = min(processors available, slices worth a thread) */
+    size_t max_threads = num_records / MIN_SLICE + 1;
+    int nthreads = get_nprocs();
+
+    if ((size_t) nthreads > max_threads) nthreads = max_threads;
+
+    slice_t *slices = calloc(nthreads, sizeof(*slices));
+
+    if (slices == NULL) {
+        /* calloc failed */
+        fail("wzstat: out of memory\n");
+    }
+
+    size_t per_thread = num_records / nthreads;
+
+    for (int i = 0; i < nthreads; i++) {
+        slices[i].data = data + i * per_thread * RECORD_SIZE;
+        slices[i].num_records = (i == nthreads - 1) ? num_records - i * per_thread
+                                                    : per_thread;
+
+        if (i > 0 && pthread_create(&slices[i].thread, NULL, scan_slice, &slices[i]) != 0) {
+            fail("wzstat: cannot create thread\n");
+        }
+    }
+
+    /* the main thread takes the first slice itself */
+    scan_slice(&slices[0]);
+
+    for (int i = 1; i < nthreads; i++) {
+        pthread_join(slices[i].thread, NULL);
+    }
+
+    merge_slices(slices, nthreads, total);
+
+    free(slices);
+    if (num_records > 0) munmap((void *) data, statbuf.st_size);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc <= 1) {
+        printf("wzstat: file1 [file2 ...]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 1; i < argc; i++) {
+        stats_t stats;
+
+        stat_file(argv[i], &stats);
+
+        if (argc > 2) printf("%s%s:\n", (i > 1) ? "\n" : "", argv[i]);
+        print_stats(&stats);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+#include "arena.h"
+
+#define FIRST_CHUNK_SIZE (4 << 10)  /* bytes in an arena's first block */
+
+
+void init_arena(arena_t *arena) {
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+
+/* adds a block of at least size bytes after the last one */
+static chunk_t *add_chunk(arena_t *arena, size_t size) {
+    size_t chunk_size = (arena->current != NULL) ? arena->current->size * 2 : FIRST_CHUNK_SIZE;
+
+    while (chunk_size < size) chunk_size *= 2;
+
+    chunk_t *chunk = malloc(sizeof(chunk_t) + chunk_size);
+
+    if (chunk == NULL) {
+        /* malloc failed */
+        return NULL;
+    }
+
+    chunk->size = chunk_size;
+    chunk->used = 0;
+
+    /* blocks are only added once the last one is full */
+    chunk->next = NULL;
+
+    if (arena->current == NULL) {
+        arena->first = chunk;
+    } else {
+        arena->current->next = chunk;
+    }
+
+    arena->current = chunk;
+    return chunk;
+}
+
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    /* every piece starts where any type can go */
+    size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+    chunk_t *chunk = arena->current;
+
+    /* move on to the blocks kept from earlier lines, if this one is full */
+    while (chunk != NULL && chunk->size - chunk->used < size) {
+        chunk = chunk->next;
+
+        if (chunk != NULL) {
+            chunk->used = 0;
+            arena->current = chunk;
+        }
+    }
+
+    if (chunk == NULL && (chunk = add_chunk(arena, size)) == NULL) {
+        return NULL;
+    }
+
+    void *piece = chunk->data + chunk->used;
+
+    chunk->used += size;
+    return piece;
+}
+
+
+void reset_arena(arena_t *arena) {
+    arena->current = arena->first;
+
+    if (arena->first != NULL) arena->first->used = 0;
+}
+
+
+void free_arena(arena_t *arena) {
+    while (arena->first != NULL) {
+        chunk_t *next = arena->first->next;
+
+        free(arena->first);
+        arena->first = next;
+    }
+
+    arena->current = NULL;
+}
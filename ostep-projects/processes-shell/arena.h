@@ -0,0 +1,29 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdalign.h>
+
+#include "structs.h"
+
+
+/* sets up an empty arena; nothing is allocated until it's first used */
+void init_arena(arena_t*);
+
+
+/**
+ * Hands out size bytes, aligned for any type, from the arena. Returns NULL
+ * if a new block was needed and malloc failed.
+ **/
+void *arena_alloc(arena_t*, size_t);
+
+
+/* takes back everything handed out, keeping the blocks for reuse */
+void reset_arena(arena_t*);
+
+
+/* frees the arena's blocks */
+void free_arena(arena_t*);
+
+#endif // ARENA_H_
@@ -0,0 +1,239 @@
+#include "batch.h"
+
+#define COPY_SIZE (64 << 10)    /* read()/write() size when sendfile() can't be used */
+
+/* a line running in the background, and where its output is being kept */
+typedef struct {
+    int id;                     /* its job number; 0 if the slot is free */
+    int out;                    /* memfd standing in for its standard output */
+    int err;                    /* memfd standing in for its standard error */
+} slot_t;
+
+
+/* copies everything written to a memfd to fd, and closes the memfd */
+static void copy_output(int memfd, int fd) {
+    struct stat st;
+    off_t off = 0;
+
+    if (fstat(memfd, &st) == 0) {
+        while (off < st.st_size) {
+            ssize_t n = sendfile(fd, memfd, &off, st.st_size - off);
+
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) break;
+        }
+
+        /* sendfile() can't write to everything; the rest goes through a buffer */
+        char buffer[COPY_SIZE];
+        ssize_t n;
+
+        while (off < st.st_size && (n = pread(memfd, buffer, COPY_SIZE, off)) > 0) {
+            for (ssize_t done = 0; done < n; ) {
+                ssize_t w = write(fd, buffer + done, n - done);
+
+                if (w == -1 && errno == EINTR) continue;
+                if (w == -1) break;
+                done += w;
+            }
+            off += n;
+        }
+    }
+
+    close(memfd);
+}
+
+
+/* waits for the next line to finish, prints its output in one piece, and frees its slot */
+static void finish_next(jobs_t *jobs, slot_t *slots, size_t max_jobs) {
+    job_t *job = wait_next_job(jobs);
+
+    if (job == NULL) return;
+
+    for (size_t i = 0; i < max_jobs; i++) {
+        if (slots[i].id != job->id) continue;
+
+        copy_output(slots[i].out, STDOUT_FILENO);
+        copy_output(slots[i].err, STDERR_FILENO);
+        slots[i].id = 0;
+        break;
+    }
+
+    wait_job(jobs, job);
+}
+
+
+/**
+ * Whether a line has to run in the shell itself, after everything before
+ * it is done: a lone built-in (cd, path, exit, wait, ...), since it changes
+ * or depends on the shell's state. Built-ins in a parallel or background
+ * line run in children of their own anyway, so those lines don't count.
+ * This only looks at the line; the parsing is left to whoever runs it.
+ **/
+static bool is_barrier(const char *line) {
+    if (strchr(line, '&') != NULL) return false;
+
+    const char *start = line + strspn(line, WHITESPACE);
+    size_t len = strcspn(start, WHITESPACE ">|");
+
+    /* `time` goes with whatever it times */
+    if (len == strlen("time") && strncmp(start, "time", len) == 0) {
+        start += len + strspn(start + len, WHITESPACE);
+        len = strcspn(start, WHITESPACE ">|");
+    }
+
+    char name[len + 1];
+
+    memcpy(name, start, len);
+    name[len] = '\0';
+
+    command_type typ = get_command_type(name);
+
+    /* utilities (echo, cat, ...) change nothing in the shell */
+    return len > 0 && typ != CMD_EXTERNAL && typ != CMD_UTILITY;
+}
+
+
+/**
+ * Starts a line in a child of its own, with its output and error output
+ * going to memfds, so it can be printed all at once when the line is done.
+ **/
+static void start_line(char *line, path_t **path, jobs_t *jobs, slot_t *slot) {
+    int out = memfd_create("wish-out", MFD_CLOEXEC);
+    int err = memfd_create("wish-err", MFD_CLOEXEC);
+
+    if (out == -1 || err == -1) {
+        print_error();
+        if (out != -1) close(out);
+        if (err != -1) close(err);
+        return;
+    }
+
+    /* nothing buffered should be written twice */
+    fflush(stdout);
+
+    uint64_t start = now_ns();
+    pid_t child = fork();
+
+    if (child > 0) count_time(STAT_FORK, start);
+
+    if (child == -1) {
+        /* fork failed */
+        print_error();
+        close(out);
+        close(err);
+        return;
+    }
+
+    if (child == 0) {
+        dup2(out, STDOUT_FILENO);
+        dup2(err, STDERR_FILENO);
+        close(out);
+        close(err);
+
+        /* the line's own processes go in a table of its own */
+        free_jobs(jobs);
+        jobs = init_jobs();
+
+        if (jobs == NULL) {
+            print_error();
+            _exit(EXIT_FAILURE);
+        }
+
+        /* the line is parsed here, in the child, rather than in the shell */
+        arena_t arena;
+
+        init_arena(&arena);
+        execute_line(line, path, jobs, &arena);
+
+        wait_all_jobs(jobs);
+        fflush(stdout);
+
+        /* _exit() leaves the parent's stdio (and the batch file's offset) alone */
+        _exit(EXIT_SUCCESS);
+    }
+
+    /* the line goes in the table as a background job; its number marks the slot */
+    slot->id = run_job(jobs, &child, 1, line, true, start, false);
+
+    if (slot->id == 0) {
+        /* it couldn't be added, and has been waited for already */
+        copy_output(out, STDOUT_FILENO);
+        copy_output(err, STDERR_FILENO);
+        return;
+    }
+
+    slot->out = out;
+    slot->err = err;
+}
+
+
+void run_batch_parallel(FILE *input_stream, size_t max_jobs) {
+    char *lineptr = NULL;
+    size_t n = 0;
+    ssize_t line_size;
+    path_t *path = init_default_path();
+    jobs_t *jobs = init_jobs();
+    slot_t *slots = calloc(max_jobs, sizeof(slot_t));
+    size_t running = 0;
+    arena_t arena;
+
+    if (jobs == NULL || slots == NULL) {
+        print_error();
+        exit(EXIT_FAILURE);
+    }
+
+    init_arena(&arena);
+
+    errno = 0;
+
+    while ((line_size = getline(&lineptr, &n, input_stream)) != -1) {
+        if (lineptr[line_size - 1] == '\n') {
+            /* remove trailing newline from getline */
+            lineptr[line_size - 1] = '\0';
+        }
+
+        if (lineptr[strspn(lineptr, WHITESPACE "&")] == '\0') {
+            /* no commands in line; not worth a child */
+            continue;
+        }
+
+        if (is_barrier(lineptr)) {
+            /* everything before it finishes first; then it runs right here */
+            for (; running > 0; running--) {
+                finish_next(jobs, slots, max_jobs);
+            }
+
+            execute_line(lineptr, &path, jobs, &arena);
+            reset_arena(&arena);
+        } else {
+            if (running == max_jobs) {
+                finish_next(jobs, slots, max_jobs);
+                running--;
+            }
+
+            size_t free_slot = 0;
+
+            while (slots[free_slot].id != 0) free_slot++;
+
+            start_line(lineptr, &path, jobs, &slots[free_slot]);
+            if (slots[free_slot].id != 0) running++;
+        }
+
+        errno = 0;
+    }
+
+    if (errno != 0) {
+        /* getline failed, rather than reaching EOF */
+        print_error();
+    }
+
+    for (; running > 0; running--) {
+        finish_next(jobs, slots, max_jobs);
+    }
+
+    free(slots);
+    free(lineptr);
+    free_arena(&arena);
+    free_jobs(jobs);
+    if (path != NULL) free_path(path);
+}
@@ -0,0 +1,33 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+
+#include "structs.h"
+#include "error.h"
+#include "path.h"
+#include "tokens.h"
+#include "commands.h"
+#include "jobs.h"
+
+
+/**
+ * Runs a batch file with up to max_jobs lines at a time (wish -j N). Each
+ * line runs in a child of its own, and its output is held back until the
+ * line is done, then printed in one piece, so lines never mix their output.
+ * A line with a lone built-in (cd, path, exit, and especially wait) is a
+ * barrier: it runs once every line before it is done, and no line after it
+ * starts until it has run.
+ **/
+void run_batch_parallel(FILE*, size_t);
+
+#endif // BATCH_H_
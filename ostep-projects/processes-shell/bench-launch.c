@@ -0,0 +1,184 @@
+/*
+** Microbenchmark for the ways wish can launch an external command: fork()
+** and execv() in the child, as the shell used to, posix_spawn(), which it
+** uses by default, and a pool of helpers forked ahead of time (wish -z N),
+** which only have to be sent the command. Each launch runs /bin/true and
+** waits for it. The launch latency, from asking for the command until it
+** has been exec'd, is printed as its median and 99th percentile, along
+** with commands per second.
+**
+** Usage: ./bench-launch [launches] [MiB of memory]
+**
+** The second argument gives the benchmark that much touched heap memory
+** first, like a shell that has been running for a while. fork() has to copy
+** the page tables for all of it (and take copy-on-write faults afterwards);
+** posix_spawn() shares them with the parent until the exec. A helper has
+** been forked before it is needed, while the shell would be idle, so the
+** time taken to replace it is left out of the numbers.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "helpers.h"
+
+#define COMMAND "/bin/true"
+#define DEFAULT_LAUNCHES 2000
+#define NUM_HELPERS 4
+
+static char *command_args[] = { COMMAND, NULL };
+
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* starts the command with fork() and execv(), and returns once the exec is done */
+static pid_t launch_fork(void) {
+    int fds[2];
+
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        perror("pipe2");
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t child = fork();
+
+    if (child == -1) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+
+    if (child == 0) {
+        execv(COMMAND, command_args);
+        _exit(EXIT_FAILURE);
+    }
+
+    /* the write end closes on exec, as posix_spawn() would wait for */
+    char c;
+
+    close(fds[1]);
+    while (read(fds[0], &c, 1) > 0);
+    close(fds[0]);
+
+    return child;
+}
+
+
+static pid_t launch_spawn(void) {
+    pid_t child;
+
+    if (posix_spawn(&child, COMMAND, NULL, NULL, command_args, environ) != 0) {
+        perror("posix_spawn");
+        exit(EXIT_FAILURE);
+    }
+
+    return child;
+}
+
+
+static pid_t launch_helpers(void) {
+    pid_t child = launch_helper(COMMAND, command_args, NULL, -1, -1);
+
+    if (child <= 0) {
+        fprintf(stderr, "no helper launched %s\n", COMMAND);
+        exit(EXIT_FAILURE);
+    }
+
+    return child;
+}
+
+
+static int compare(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * Runs launch() the given number of times and prints the median and 99th
+ * percentile of the launch latency, and the launches per second counting
+ * the waits for the commands too.
+ **/
+static void measure(const char *name, pid_t (*launch)(void), int launches) {
+    double *latency = malloc(sizeof(double) * launches);
+    double total = 0;
+
+    if (latency == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < launches; i++) {
+        /* does nothing unless there are helpers to replace */
+        refill_helpers();
+
+        double start = now();
+        pid_t child = launch();
+        double started = now();
+
+        waitpid(child, NULL, 0);
+
+        latency[i] = started - start;
+        total += now() - start;
+    }
+
+    qsort(latency, launches, sizeof(double), compare);
+
+    printf("  %-14s %8.0f %10.1f %10.1f\n", name, launches / total,
+           latency[launches / 2] * 1e6, latency[(int) (launches * 0.99)] * 1e6);
+
+    free(latency);
+}
+
+
+int main(int argc, char *argv[]) {
+    int launches = (argc > 1) ? atoi(argv[1]) : DEFAULT_LAUNCHES;
+    size_t ballast = (argc > 2) ? strtoul(argv[2], NULL, 10) << 20 : 0;
+
+    if (launches <= 0) {
+        fprintf(stderr, "usage: %s [launches] [MiB of memory]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ballast > 0) {
+        char *memory = mmap(NULL, ballast, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            perror("mmap");
+            exit(EXIT_FAILURE);
+        }
+
+        /* ordinary 4 KiB pages, as a heap built of small allocations would
+         * mostly have, each touched so it's really mapped */
+        madvise(memory, ballast, MADV_NOHUGEPAGE);
+        memset(memory, 1, ballast);
+    }
+
+    if (!init_helpers(NUM_HELPERS)) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%d launches of %s with %zu MiB in use:\n", launches, COMMAND, ballast >> 20);
+    printf("  %-14s %8s %10s %10s\n", "", "cmds/s", "p50 (us)", "p99 (us)");
+    measure("fork + execv", launch_fork, launches);
+    measure("posix_spawn", launch_spawn, launches);
+    measure("helpers", launch_helpers, launches);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/*
+** Benchmark for the shell's parser: how many lines a second it gets
+** through, splitting each at '&' and '|', finding its redirects, and
+** breaking every command into its args, just as the shell does before
+** running a line (nothing is run here).
+**
+** Usage: ./bench-parse [batch file] [rounds]
+**
+** Without a batch file, a made-up one of DEFAULT_LINES lines is used. Each
+** line is copied into a buffer first, as getline() would leave it, since
+** parsing cuts the line up; the copy is included in the time.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "commands.h"
+
+#define DEFAULT_LINES 200000
+#define DEFAULT_ROUNDS 5
+
+static char *sample_lines[] = {
+    "ls -l /tmp",
+    "grep -n pattern file.txt > matches.txt",
+    "echo a b c d e f g & wc -l data.csv & sort -u names.txt",
+    "cat input.txt | sort | uniq -c > counts.txt",
+    "make -C src all & cp -r build /tmp/backup",
+};
+
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* parses one command, or each stage of a pipeline; returns how many there were */
+static size_t parse_command(char *cmd_string, arena_t *arena) {
+    char *redir_file;
+
+    if (strchr(cmd_string, '|') == NULL) {
+        parse_redirect(cmd_string, &redir_file);
+        return get_command(cmd_string, arena) != NULL;
+    }
+
+    tokens_t *stages = split_pipeline(cmd_string, arena);
+    size_t count = 0;
+
+    for (size_t i = 0; stages != NULL && i < stages->num; i++) {
+        parse_redirect(stages->tokens[i], &redir_file);
+        count += get_command(stages->tokens[i], arena) != NULL;
+    }
+
+    return count;
+}
+
+
+int main(int argc, char *argv[]) {
+    int rounds = (argc > 2) ? atoi(argv[2]) : DEFAULT_ROUNDS;
+    char **lines = NULL;
+    size_t num_lines = 0, bytes = 0, longest = 0;
+
+    if (argc > 1) {
+        FILE *batch = fopen(argv[1], "r");
+        char *lineptr = NULL;
+        size_t n = 0, cap = 0;
+        ssize_t len;
+
+        if (batch == NULL) {
+            perror(argv[1]);
+            exit(EXIT_FAILURE);
+        }
+
+        while ((len = getline(&lineptr, &n, batch)) != -1) {
+            if (lineptr[len - 1] == '\n') lineptr[len - 1] = '\0';
+
+            if (num_lines == cap) {
+                cap = (cap > 0) ? cap * 2 : 1024;
+                lines = realloc(lines, sizeof(char *) * cap);
+            }
+
+            lines[num_lines++] = strdup(lineptr);
+        }
+
+        free(lineptr);
+        fclose(batch);
+    } else {
+        size_t num_samples = sizeof(sample_lines) / sizeof(sample_lines[0]);
+
+        lines = malloc(sizeof(char *) * DEFAULT_LINES);
+
+        for (num_lines = 0; num_lines < DEFAULT_LINES; num_lines++) {
+            lines[num_lines] = sample_lines[num_lines % num_samples];
+        }
+    }
+
+    if (lines == NULL || rounds <= 0) {
+        fprintf(stderr, "usage: %s [batch file] [rounds]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < num_lines; i++) {
+        size_t len = strlen(lines[i]) + 1;
+
+        bytes += len;
+        if (len > longest) longest = len;
+    }
+
+    char *buffer = malloc(longest);
+    arena_t arena;
+    size_t commands = 0;
+
+    init_arena(&arena);
+
+    double start = now();
+
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < num_lines; i++) {
+            memcpy(buffer, lines[i], strlen(lines[i]) + 1);
+
+            tokens_t *tokens = tokenize_line(buffer, &arena);
+
+            for (size_t j = 0; tokens != NULL && j < tokens->num; j++) {
+                commands += parse_command(tokens->tokens[j], &arena);
+            }
+
+            reset_arena(&arena);
+        }
+    }
+
+    double elapsed = now() - start;
+
+    printf("%zu lines (%zu commands) parsed %d times:\n", num_lines, commands / rounds, rounds);
+    printf("  %10.0f lines/s\n", num_lines * rounds / elapsed);
+    printf("  %10.1f MB/s\n", bytes * rounds / elapsed / 1e6);
+
+    return EXIT_SUCCESS;
+}
@@ -1,204 +1,195 @@
 #include "commands.h"
 #include "tokens.h"
 
+#define PIPE_SIZE (1 << 20)     /* capacity asked for each pipe of a pipeline */
+
+
 command_type get_command_type(char *command) {
     if(strcmp(command, "exit") == 0) return CMD_EXIT;
     if(strcmp(command, "cd") == 0) return CMD_CD;
     if(strcmp(command, "path") == 0) return CMD_PATH;
+    if(strcmp(command, "jobs") == 0) return CMD_JOBS;
+    if(strcmp(command, "wait") == 0) return CMD_WAIT;
+    if(find_utility(command) != NULL) return CMD_UTILITY;
 
     return CMD_EXTERNAL;
 }
 
 
-command_t *get_command(char *line) {
-    command_t *cmd = malloc(sizeof(command_t));
+command_t *get_command(char *line, arena_t *arena) {
+    /* a line of n characters has at most (n + 1) / 2 words; one more for the
+     * NULL that ends the args of an external command */
+    size_t max_args = (strlen(line) + 1) / 2 + 1;
+    command_t *cmd = arena_alloc(arena, sizeof(command_t));
+    char **args = arena_alloc(arena, sizeof(char *) * max_args);
 
-    if (cmd == NULL) {
+    if (cmd == NULL || args == NULL) {
         /* malloc failed */
         return NULL;
     }
 
     cmd->argc = 0;
-    cmd->args = NULL;
+    cmd->args = args;
 
-
-    char *token, *saveptr, *tmp;
+    char *token, *saveptr;
 
     token = strtok_r(line, WHITESPACE, &saveptr);
 
     if (token == NULL) {
         /* no commands found */
-        free(cmd);
         return NULL;
     }
 
     cmd->typ = get_command_type(token);
 
-    if (cmd->typ == CMD_EXTERNAL) {
+    if (cmd->typ == CMD_EXTERNAL || cmd->typ == CMD_UTILITY) {
         /* external commands need command name included in args */
-        cmd->args = malloc(sizeof(cmd->args));
+        cmd->args[cmd->argc++] = token;
+    }
 
-        if (cmd->args == NULL) {
-            /* malloc failed; cleanup and return */
-            free(cmd);
-            return NULL;
-        }
+    /* parse rest of the args; they stay where they are in the line */
+    while ((token = strtok_r(NULL, WHITESPACE, &saveptr)) != NULL) {
+        cmd->args[cmd->argc++] = token;
+    }
 
-        tmp = malloc(sizeof(char) * (strlen(token) + 1));
+    /* pad null arg for posix_spawn() */
+    cmd->args[cmd->argc] = NULL;
 
-        if (tmp == NULL) {
-            /* malloc failed; cleanup and return */
-            free(cmd->args);
-            free(cmd);
-            return NULL;
-        }
+    return cmd;
+}
 
-        strncpy(tmp, token, strlen(token) + 1);
 
-        cmd->args[cmd->argc] = tmp;
-        cmd->argc++;
+void print_command(command_t *cmd) {
+    printf("Command type: %d\targc: %ld\nargs: ", cmd->typ, cmd->argc);
+    for (int i = 0; i < cmd->argc; i++) {
+        printf("%s ", cmd->args[i]);
     }
+    printf("\n");
+}
 
-    bool m_fail = false;
 
-    /* parse rest of the args */
-    while ((token = strtok_r(NULL, WHITESPACE, &saveptr)) != NULL) {
-        tmp = malloc(sizeof(char) * (strlen(token) + 1));
+/**
+ * Points stdout and stderr at a file for a command run in the shell itself,
+ * keeping the originals in saved (-1 for one that wasn't open). Returns
+ * false, after printing an error, if the file can't be opened.
+ **/
+static bool redirect_output(const char *file, int saved[2]) {
+    /* what was printed before belongs where it was going */
+    fflush(stdout);
+    fflush(stderr);
 
-        if (tmp == NULL) {
-            /* malloc failed */
-            m_fail = true;
-            break;
-        }
+    int fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
 
-        strncpy(tmp, token, strlen(token) + 1);
+    if (fd == -1) {
+        print_error();
+        return false;
+    }
 
-        char** re_tmp = realloc(cmd->args, sizeof(char *) * (cmd->argc + 1));
+    saved[0] = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+    saved[1] = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 3);
 
-        if (re_tmp == NULL) {
-            /* realloc failed */
-            m_fail = true;
-            break;
-        }
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
 
-        cmd->args = re_tmp;
-        cmd->args[cmd->argc] = tmp;
-        cmd->argc++;
-    }
+    return true;
+}
 
-    if (m_fail) {
-        /* malloc failed in loop; cleanup and return */
-        free_command(cmd);
-        return NULL;
-    }
 
-    if (cmd->typ == CMD_EXTERNAL) {
-        /* pad null arg for execv() */
-        char **re_tmp = realloc(cmd->args, sizeof(char *) * (cmd->argc + 1));
+/* puts stdout and stderr back the way redirect_output() found them */
+static void restore_output(int saved[2]) {
+    fflush(stdout);
+    fflush(stderr);
 
-        if (re_tmp == NULL) {
-            /* realloc failed; cleanup and return */
-            free_command(cmd);
-            return NULL;
-        }
+    for (int i = 0; i < 2; i++) {
+        int fd = (i == 0) ? STDOUT_FILENO : STDERR_FILENO;
 
-        cmd->args = re_tmp;
-        cmd->args[cmd->argc] = NULL;
+        if (saved[i] == -1) {
+            close(fd);
+            continue;
+        }
 
+        dup2(saved[i], fd);
+        close(saved[i]);
     }
-
-    return cmd;
 }
 
 
-void free_command(command_t *cmd) {
-    if (cmd == NULL) return;
+/* the `time` report for a command run in the shell itself, since start */
+static void print_own_times(uint64_t start, const struct rusage *before) {
+    struct rusage usage;
 
-    if (cmd->args != NULL) {
-        for (int i = 0; i < cmd->argc; i++) {
-            if (cmd->args[i] != NULL) free(cmd->args[i]);
-        }
-        free(cmd->args);
-    }
-
-    free(cmd);
-    return;
-}
+    getrusage(RUSAGE_SELF, &usage);
 
+    /* the shell's largest resident set so far is all there is to go by */
+    timersub(&usage.ru_utime, &before->ru_utime, &usage.ru_utime);
+    timersub(&usage.ru_stime, &before->ru_stime, &usage.ru_stime);
+    usage.ru_nvcsw -= before->ru_nvcsw;
+    usage.ru_nivcsw -= before->ru_nivcsw;
 
-void print_command(command_t *cmd) {
-    printf("Command type: %d\targc: %ld\nargs: ", cmd->typ, cmd->argc);
-    for (int i = 0; i < cmd->argc; i++) {
-        printf("%s ", cmd->args[i]);
-    }
-    printf("\n");
+    print_times(now_ns() - start, &usage);
 }
 
 
-void execute_command(char *cmd_string, path_t **path) {
+void execute_command(char *cmd_string, path_t **path, jobs_t *jobs, arena_t *arena) {
     if (cmd_string == NULL || path == NULL) {
         print_error();
         return;
     }
 
-    char *redir_file;
-    int has_redirect = parse_redirect(cmd_string, &redir_file);
+    /* look the command up here, so the parent's hash table remembers it */
+    plan_t plan;
+    int ready = prepare_command(cmd_string, *path, &plan, arena);
 
-    if (has_redirect == -1) {
+    if (ready == -1) {
+        /* bad syntax, or a command that's not executable */
         print_error();
-        return;
     }
 
-    command_t *cmd = get_command(cmd_string);
+    if (ready != 1) return;
 
-    if (cmd == NULL) {
-        return;
-    }
+    command_t *cmd = plan.cmds[0];
+    uint64_t start = now_ns();
 
-    if (has_redirect == 0) {
-        /* command has no redirect */
-        redir_file = NULL;
-    }
+    if (plan.num == 1 && cmd->typ != CMD_EXTERNAL) {
+        /* no fork or exec for these; a redirect holds while they run */
+        int saved[2];
+        struct rusage before;
 
-    if (cmd->typ != CMD_EXTERNAL) {
-        execute_built_in_command(cmd, path);
-    } else {
-        /* execute external command in child process */
-        int wstatus;
-        pid_t child_proc = fork();
-
-        if (child_proc == -1) {
-            /* fork failed */
-            print_error();
-            free_command(cmd);
-            return;
-        }
+        if (plan.timed) getrusage(RUSAGE_SELF, &before);
 
-        if (child_proc == 0) {
-            /* execute external command in child */
-            execute_external_command(cmd, *path, redir_file);
+        if (plan.redir_file != NULL && !redirect_output(plan.redir_file, saved)) return;
 
-            /* returning here means execv() failed */
-            print_error();
-            free_command(cmd);
-            exit(EXIT_FAILURE);
+        if (cmd->typ == CMD_UTILITY) {
+            run_utility(cmd);
         } else {
-            /* parent simply waits for the child to finish */
-            waitpid(child_proc, &wstatus, 0);
+            execute_built_in_command(cmd, path, jobs);
         }
+
+        if (plan.redir_file != NULL) restore_output(saved);
+
+        count_command(start, now_ns());
+        if (plan.timed) print_own_times(start, &before);
+        return;
     }
 
-    free_command(cmd);
+    /* all the stages of a pipeline run at once; wait for every one */
+    pid_t pids[plan.num];
+    size_t count = start_command(&plan, pids);
+
+    run_job(jobs, pids, count, NULL, false, start, plan.timed);
 }
 
 
-void execute_built_in_command(command_t *cmd, path_t **path) {
+void execute_built_in_command(command_t *cmd, path_t **path, jobs_t *jobs) {
     switch(cmd->typ) {
         case CMD_EXIT:
             if (cmd->argc > 0) {
                 print_error();
                 return;
             }
+            /* background jobs get to finish (and write their output) first */
+            wait_all_jobs(jobs);
             exit(EXIT_SUCCESS);
 
         case CMD_CD:
@@ -207,7 +198,12 @@ void execute_built_in_command(command_t *cmd, path_t **path) {
                 print_error();
                 return;
             }
-            execute_cd(cmd->args[0]);
+            if (execute_cd(cmd->args[0])) {
+                /* relative paths now lead elsewhere, and the helpers
+                 * are still where the shell was */
+                path_cwd_changed(*path);
+                reset_helpers();
+            }
             break;
 
         case CMD_PATH:
@@ -215,6 +211,18 @@ void execute_built_in_command(command_t *cmd, path_t **path) {
             *path = execute_path(cmd, path);
             break;
 
+        case CMD_JOBS:
+            if (cmd->argc > 0) {
+                print_error();
+                return;
+            }
+            list_jobs(jobs);
+            break;
+
+        case CMD_WAIT:
+            execute_wait(cmd, jobs);
+            break;
+
         default:
             /* we should never reach here */
             print_error();
@@ -223,17 +231,44 @@ void execute_built_in_command(command_t *cmd, path_t **path) {
 }
 
 
-void execute_cd(char *directory) {
+bool execute_cd(char *directory) {
     if (chdir(directory) == 0) {
-        return;
+        return true;
     }
 
     /* cd failed */
     print_error();
+    return false;
+}
+
+
+void execute_wait(command_t *cmd, jobs_t *jobs) {
+    if (cmd->argc == 0) {
+        wait_all_jobs(jobs);
+        return;
+    }
+
+    /* a job is given by its number, as `jobs` shows it, with or without a '%' */
+    char *id = cmd->args[0], *end;
+
+    if (*id == '%') id++;
+
+    long n = strtol(id, &end, 10);
+    job_t *job = (cmd->argc == 1 && *id != '\0' && *end == '\0' && n > 0 && n <= INT_MAX)
+                 ? find_job(jobs, n) : NULL;
+
+    if (job == NULL) {
+        /* too many arguments, or no such job */
+        print_error();
+        return;
+    }
+
+    wait_job(jobs, job);
 }
 
 
 path_t *execute_path(command_t *cmd, path_t **p) {
+    /* the new path comes with an empty command hash table */
     path_t *new_p = add_paths(cmd);
 
     if (new_p == NULL) {
@@ -248,141 +283,341 @@ path_t *execute_path(command_t *cmd, path_t **p) {
 
 
 
-void execute_external_command(command_t *cmd, path_t *path, char *redir_file) {
-    /* check if command is executable */
-    char *exec_path = isExecutable(cmd, path);
+pid_t launch_external_command(command_t *cmd, char *exec_path, char *redir_file,
+                             int in_fd, int out_fd) {
+    posix_spawn_file_actions_t actions;
+    pid_t child_proc = launch_helper(exec_path, cmd->args, redir_file, in_fd, out_fd);
 
-    if (exec_path == NULL) {
-        /* command not executable */
-        return;
+    if (child_proc != 0) {
+        /* a helper took it (or it failed there) */
+        return child_proc;
     }
 
+    if (posix_spawn_file_actions_init(&actions) != 0) {
+        print_error();
+        return -1;
+    }
 
     if (redir_file != NULL) {
-        /* redirect stdout to file */
-        FILE *fp = freopen(redir_file, "w+", stdout);
-
-        if (fp == NULL) {
-            return;
+        /* redirect stdout to the file, and stderr along with it */
+        if (posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, redir_file,
+                                             O_RDWR | O_CREAT | O_TRUNC, 0666) != 0 ||
+            posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO) != 0) {
+            posix_spawn_file_actions_destroy(&actions);
+            print_error();
+            return -1;
         }
+    }
 
-        /* redirect stdee to stdout, i.e., to the file a */
-        if (dup2(fileno(stdout), fileno(stderr)) == -1) {
-            return;
-        }
+    /* pipe ends become stdin and stdout; the originals are close-on-exec */
+    if ((in_fd != -1 && posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO) != 0) ||
+        (out_fd != -1 && posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO) != 0)) {
+        posix_spawn_file_actions_destroy(&actions);
+        print_error();
+        return -1;
     }
 
-    /* execute command */
-    execv(exec_path, cmd->args);
+    /* glibc starts the child with clone(CLONE_VM | CLONE_VFORK), so the
+     * shell's page tables are never copied; a failed open or exec in the
+     * child comes back here as the error */
+    int err = posix_spawn(&child_proc, exec_path, &actions, NULL, cmd->args, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err != 0) {
+        print_error();
+        return -1;
+    }
 
-    /* returning here is an error */
-    free(exec_path);
+    return child_proc;
 }
 
 
-void execute_commands_in_parallel(tokens_t *tkn, path_t **path) {
-    if (tkn == NULL) {
-        /* given tokens variable is empty */
+pid_t launch_utility(command_t *cmd, char *redir_file, int in_fd, int out_fd) {
+    /* nothing buffered should be written twice */
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t child_proc = fork();
+
+    if (child_proc == -1) {
+        /* fork failed */
         print_error();
-        return;
+        return -1;
     }
 
-    pid_t pids[tkn->num];
-    int wstatus[tkn->num];
-    size_t count = 0;
+    if (child_proc > 0) return child_proc;
 
-    for (int i = 0; i < tkn->num; i++) {
-        pid_t p_fork = fork();
+    if (redir_file != NULL) {
+        int fd = open(redir_file, O_RDWR | O_CREAT | O_TRUNC, 0666);
 
-        if (p_fork == -1) {
-            /* fork failed */
+        if (fd == -1) {
             print_error();
+            _exit(EXIT_FAILURE);
+        }
+
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+    }
+
+    if (in_fd != -1) dup2(in_fd, STDIN_FILENO);
+    if (out_fd != -1) dup2(out_fd, STDOUT_FILENO);
+
+    /* without an exec, nothing is closed on exec: the shell's descriptors
+     * (the other ends of the pipes among them) have to go by hand, or a
+     * reader could wait forever for the end of its input */
+    close_range(3, ~0U, 0);
+
+    /* _exit() leaves the parent's stdio (and the batch file's offset) alone */
+    _exit(run_utility(cmd));
+}
+
+
+int prepare_command(char *cmd_string, path_t *path, plan_t *plan, arena_t *arena) {
+    char *single[] = { cmd_string };
+    tokens_t one = { single, 1 };
+    tokens_t *stages = &one;
+
+    if (strchr(cmd_string, '|') != NULL && (stages = split_pipeline(cmd_string, arena)) == NULL) {
+        /* a stage is empty */
+        return -1;
+    }
+
+    plan->num = stages->num;
+    plan->cmds = arena_alloc(arena, sizeof(command_t *) * plan->num);
+    plan->exec_paths = arena_alloc(arena, sizeof(char *) * plan->num);
+    plan->redir_file = NULL;
+
+    if (plan->cmds == NULL || plan->exec_paths == NULL) {
+        /* malloc failed */
+        return -1;
+    }
+
+    /* a leading `time` times the whole command, every stage of it */
+    char *first = stages->tokens[0] + strspn(stages->tokens[0], WHITESPACE);
+    size_t len = strcspn(first, WHITESPACE);
+
+    plan->timed = (len == strlen("time") && strncmp(first, "time", len) == 0);
+
+    if (plan->timed) {
+        /* on its own, it has nothing to time */
+        if (first[len] == '\0') return 0;
+
+        stages->tokens[0] = first + len;
+    }
+
+    for (size_t i = 0; i < plan->num; i++) {
+        char *redir_file;
+        int has_redirect = parse_redirect(stages->tokens[i], &redir_file);
+
+        if (has_redirect == -1 || (has_redirect == 1 && i != plan->num - 1)) {
+            /* bad redirect, or output redirected away from the next stage */
+            return -1;
+        }
+
+        if (has_redirect == 1) plan->redir_file = redir_file;
+
+        command_t *cmd = plan->cmds[i] = get_command(stages->tokens[i], arena);
+
+        if (cmd == NULL) {
+            /* nothing but whitespace; only an error in a pipeline */
+            return (plan->num == 1) ? 0 : -1;
+        }
+
+        plan->exec_paths[i] = NULL;
+
+        /* a utility is built in, so there's nothing to look up; it stands in
+         * for a program on the path, though, and with an empty path the spec
+         * runs nothing but the built-ins */
+        if (cmd->typ == CMD_UTILITY) {
+            if (path->num == 0) return -1;
             continue;
         }
 
-        if (p_fork == 0) {
-            /* execute command in child */
-            char *redir_file;
-            int has_redirect = parse_redirect(tkn->tokens[i], &redir_file);
+        if (cmd->typ != CMD_EXTERNAL) {
+            /* a built-in can't be a stage of a pipeline */
+            if (plan->num > 1) return -1;
+            continue;
+        }
 
-            if (has_redirect == -1) {
-                /* incorrect redirect syntax */
-                print_error();
-                exit(EXIT_FAILURE);
-            }
+        if ((plan->exec_paths[i] = find_command(path, cmd->args[0])) == NULL) {
+            /* command not executable */
+            return -1;
+        }
+    }
 
-            command_t *cmd = get_command(tkn->tokens[i]);
+    return 1;
+}
 
-            if (cmd == NULL) {
-                /* could not extract a command from string token */
-                print_error();
-                exit(EXIT_FAILURE);
-            }
 
-            if (has_redirect == 0) {
-                /* command has no redirect */
-                redir_file = NULL;
-            }
+size_t start_command(plan_t *plan, pid_t *pids) {
+    size_t count = 0;
+    int in_fd = -1;
 
-            if (cmd->typ != CMD_EXTERNAL) {
-                /* command is a built-in command */
-                execute_built_in_command(cmd, path);
-            } else {
-                execute_external_command(cmd, *path, redir_file);
+    for (size_t i = 0; i < plan->num; i++) {
+        int fds[2] = { -1, -1 };
 
-                /* returning here means execv() failed */
+        if (i < plan->num - 1) {
+            if (pipe2(fds, O_CLOEXEC) == -1) {
                 print_error();
-                free_command(cmd);
-                exit(EXIT_FAILURE);
+                break;
             }
 
-            free_command(cmd);
-            exit(EXIT_SUCCESS);
-
-        } else {
-            /* parent stores the process ID and executes next command */
-            pids[count++] = p_fork;
+            /* a bigger pipe lets the writer run further ahead of the
+             * reader before either has to sleep; this is only a hint */
+            fcntl(fds[1], F_SETPIPE_SZ, PIPE_SIZE);
         }
+
+        char *redir_file = (i == plan->num - 1) ? plan->redir_file : NULL;
+        bool utility = (plan->cmds[i]->typ == CMD_UTILITY);
+        uint64_t start = now_ns();
+        pid_t child_proc = utility
+                           ? launch_utility(plan->cmds[i], redir_file, in_fd, fds[1])
+                           : launch_external_command(plan->cmds[i], plan->exec_paths[i],
+                                                     redir_file, in_fd, fds[1]);
+
+        /* a utility is only forked; anything else returns once it's exec'd */
+        count_time(utility ? STAT_FORK : STAT_EXEC, start);
+
+        /* the children have their copies of the pipe ends now */
+        if (in_fd != -1) close(in_fd);
+        if (fds[1] != -1) close(fds[1]);
+        in_fd = fds[0];
+
+        if (child_proc != -1) pids[count++] = child_proc;
+    }
+
+    if (in_fd != -1) close(in_fd);
+
+    return count;
+}
+
+
+/* the commands of a line joined back together, for `jobs` to show */
+static char *join_commands(tokens_t *tkn, arena_t *arena) {
+    size_t len = 1;
+
+    for (int i = 0; i < tkn->num; i++) {
+        len += strlen(tkn->tokens[i]) + strlen(" & ");
     }
 
-    /* only parent will return here */
-    for (int i = 0; i < count; i++) {
-        /* wait for all childs to terminate */
-        waitpid(pids[i], &wstatus[i], 0);
+    char *line = arena_alloc(arena, len);
+
+    if (line == NULL) {
+        /* malloc failed */
+        return NULL;
     }
+
+    line[0] = '\0';
+
+    for (int i = 0; i < tkn->num; i++) {
+        char *start = tkn->tokens[i] + strspn(tkn->tokens[i], WHITESPACE);
+        size_t n = strlen(start);
+
+        while (n > 0 && strchr(WHITESPACE, start[n - 1]) != NULL) n--;
+        if (n == 0) continue;
+
+        if (line[0] != '\0') strcat(line, " & ");
+        strncat(line, start, n);
+    }
+
+    return line;
 }
 
 
-char* isExecutable(command_t *cmd, path_t *path) {
-    char *full_path, *curr;
+void execute_commands_in_parallel(tokens_t *tkn, path_t **path, jobs_t *jobs, bool background,
+                                  arena_t *arena) {
+    if (tkn == NULL) {
+        /* given tokens variable is empty */
+        print_error();
+        return;
+    }
+
+    plan_t *plans = arena_alloc(arena, sizeof(plan_t) * tkn->num);
+    size_t num_plans = 0, max_procs = 0;
+
+    if (plans == NULL) {
+        /* malloc failed */
+        print_error();
+        return;
+    }
+
+    /* taken before parsing cuts the commands up */
+    char *line = background ? join_commands(tkn, arena) : NULL;
+
+    /* every command is parsed and looked up here, where the hash table
+     * lives, before any is started: a bad one costs no fork, and the rest
+     * then start back to back */
+    for (int i = 0; i < tkn->num; i++) {
+        if (prepare_command(tkn->tokens[i], *path, &plans[num_plans], arena) != 1) {
+            /* bad syntax, no command at all, or not executable */
+            print_error();
+            continue;
+        }
+
+        max_procs += plans[num_plans++].num;
+    }
+
+    pid_t pids[max_procs + 1];
+    size_t count = 0;
+    uint64_t start = now_ns();
+    bool timed = false;
 
-    /* traverse each path, append command to path string and check if executable */
-    for (int i = 0, cmd_len = strlen(cmd->args[0]); i < path->num; i++) {
-        curr = path->paths[i];  /* current path */
-        int p_len = strlen(curr);
+    for (size_t i = 0; i < num_plans; i++) {
+        command_t *cmd = plans[i].cmds[0];
 
-        full_path = malloc(p_len + cmd_len + 2); /* initialize appended string */
-        if (full_path == NULL) {
-            /* malloc failed */
-            return NULL;
+        /* the line is one job, so `time` on any of its commands times it all */
+        if (plans[i].timed) timed = true;
+
+        if (cmd->typ == CMD_EXTERNAL || cmd->typ == CMD_UTILITY) {
+            /* a pipeline's stages are started alongside the other commands */
+            count += start_command(&plans[i], pids + count);
+            continue;
         }
 
-        full_path[0] = '\0';
+        /* a built-in runs in a child of its own, so it has no effect on the shell */
+        uint64_t fork_start = now_ns();
+        pid_t p_fork = fork();
 
-        strncat(full_path, curr, p_len); /* copy current path */
+        if (p_fork > 0) count_time(STAT_FORK, fork_start);
 
-        full_path[p_len] = '/'; /* add '/' before appending command */
-        full_path[p_len + 1] = '\0';
+        if (p_fork == -1) {
+            /* fork failed */
+            print_error();
+            continue;
+        }
 
-        strncat(full_path, cmd->args[0], cmd_len); /* append command */
+        if (p_fork == 0) {
+            /* exit would only end this child, and it has no children to wait for */
+            if ((cmd->typ != CMD_EXIT || cmd->argc > 0) && cmd->typ != CMD_WAIT) {
+                execute_built_in_command(cmd, path, jobs);
+            }
 
-        if (access(full_path, X_OK) == 0) {
-            /* command is executable */
-            return full_path;
+            /* _exit() leaves the parent's stdio (and the batch file's offset) alone */
+            _exit(EXIT_SUCCESS);
         }
 
-        free(full_path);
+        pids[count++] = p_fork;
     }
 
-    return NULL;
+    /* only parent will return here; in the foreground, wait for all childs */
+    run_job(jobs, pids, count, line, background, start, timed);
+}
+
+
+void execute_line(char *line, path_t **path, jobs_t *jobs, arena_t *arena) {
+    bool background = is_background(line);
+    tokens_t *tokens = tokenize_line(line, arena);
+
+    if (tokens == NULL) {
+        /* no valid tokens in line */
+        return;
+    }
+
+    if (tokens->num == 1 && !background) {
+        /* execute the single command */
+        execute_command(tokens->tokens[0], path, jobs, arena);
+    } else {
+        execute_commands_in_parallel(tokens, path, jobs, background, arena);
+    }
 }
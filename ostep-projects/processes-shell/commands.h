@@ -10,33 +10,95 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <spawn.h>
+#include <limits.h>
 
 #include "path.h"
 #include "error.h"
 #include "tokens.h"
+#include "jobs.h"
+#include "arena.h"
+#include "utilities.h"
+#include "helpers.h"
+#include "stats.h"
 
 
 command_type get_command_type(char*);
 
-command_t *get_command(char*);
-
-void free_command(command_t*);
+/**
+ * Parses a command in place: the args point into the line, and the command
+ * and its args array are taken from the arena. Returns NULL if the line is
+ * empty (or malloc failed).
+ **/
+command_t *get_command(char*, arena_t*);
 
 void print_command(command_t*);
 
-void execute_command(char*, path_t**);
+/**
+ * Runs a single command (or pipeline) in the foreground. Built-ins and
+ * utilities on their own run in the shell itself, with their output
+ * redirected for the time being if the command says so.
+ **/
+void execute_command(char*, path_t**, jobs_t*, arena_t*);
 
-void execute_built_in_command(command_t*, path_t**);
+void execute_built_in_command(command_t*, path_t**, jobs_t*);
 
-void execute_cd(char*);
+bool execute_cd(char*);
 
 path_t *execute_path(command_t*, path_t**);
 
-void execute_external_command(command_t*, path_t*, char*);
-
-void execute_commands_in_parallel(tokens_t*, path_t**);
-
-char* isExecutable(command_t*, path_t*);
+/**
+ * The `wait` built-in: waits for the background job given by its number, or
+ * for all of them if none is given.
+ **/
+void execute_wait(command_t*, jobs_t*);
+
+/**
+ * Starts an external command through an idle helper if there is one, or
+ * else with posix_spawn(), with its output (and error
+ * output) redirected to redir_file unless that is NULL. in_fd and out_fd,
+ * unless -1, become its standard input and output. Returns the child's
+ * process ID, or -1 after printing an error.
+ **/
+pid_t launch_external_command(command_t*, char*, char*, int, int);
+
+/**
+ * Runs a utility in a child of its own, which is forked but never execs,
+ * with the same redirection and pipe ends as launch_external_command().
+ * Returns the child's process ID, or -1 after printing an error.
+ **/
+pid_t launch_utility(command_t*, char*, int, int);
+
+/**
+ * Parses a command, or a pipeline ("cmd1 | cmd2 | ..."), and looks up the
+ * executables, without starting anything. Only external commands and
+ * utilities can be stages of a pipeline, and only the last may redirect its output. Returns
+ * 1 if the command is ready to start, 0 if there's no command at all, and
+ * -1 if it's wrong in any way.
+ **/
+int prepare_command(char*, path_t*, plan_t*, arena_t*);
+
+/**
+ * Starts a prepared external command or utility, or every stage of a pipeline at once,
+ * each one's output piped into the next one's input. Stores the process IDs
+ * in pids, which needs room for one per stage, and returns how many were
+ * started.
+ **/
+size_t start_command(plan_t*, pid_t*);
+
+/**
+ * Starts the '&' separated commands of a line all at once. In the
+ * foreground, waits for them all to finish; in the background (the line
+ * ended in '&'), adds them to the job table and returns.
+ **/
+void execute_commands_in_parallel(tokens_t*, path_t**, jobs_t*, bool, arena_t*);
+
+/**
+ * Runs a line of input: a single command in the foreground, otherwise its
+ * commands in parallel. Parsing cuts the line up and takes what it needs
+ * from the arena, which the caller resets once the line is done.
+ **/
+void execute_line(char*, path_t**, jobs_t*, arena_t*);
 
 
 #endif // COMMANDS_H_
@@ -0,0 +1,254 @@
+#include "helpers.h"
+
+#define NUM_FDS 3               /* standard input, output and error */
+
+/* the shell's only pool; empty unless wish -z N set one up */
+static helpers_t pool = { NULL, 0, 0, 0 };
+
+
+/**
+ * What a helper does with its life: waits for a command, then execs it.
+ * A command comes as one message, the executable's path and then the args,
+ * each ending in '\0', with the descriptors for its standard input, output
+ * and error attached. If the exec fails, errno goes back to the shell; if
+ * it works, the close-on-exec socket tells the shell so by closing.
+ **/
+static void run_helper(int sock) {
+    ssize_t len;
+
+    /* the shell's own descriptors aren't the command's business */
+    close_range(3, sock - 1, 0);
+    close_range(sock + 1, ~0U, 0);
+
+    /* the size of the message, without taking it yet */
+    while ((len = recv(sock, NULL, 0, MSG_PEEK | MSG_TRUNC)) == -1 && errno == EINTR);
+
+    if (len <= 0) {
+        /* the shell has gone, or let this helper go */
+        _exit(EXIT_SUCCESS);
+    }
+
+    char *data = malloc(len + 1);
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * NUM_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = data, .iov_len = len };
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control.buf, .msg_controllen = sizeof(control.buf)
+    };
+
+    if (data == NULL || recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != len) _exit(EXIT_FAILURE);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+    if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int) * NUM_FDS)) {
+        _exit(EXIT_FAILURE);
+    }
+
+    int fds[NUM_FDS];
+
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    for (int i = 0; i < NUM_FDS; i++) {
+        dup2(fds[i], i);
+    }
+
+    /* the args, each pointing into the message; the path comes first */
+    data[len] = '\0';
+
+    size_t argc = 0;
+
+    for (ssize_t i = 0; i < len; i++) {
+        if (data[i] == '\0') argc++;
+    }
+
+    char **args = malloc(sizeof(char *) * argc);
+
+    if (args == NULL) _exit(EXIT_FAILURE);
+
+    char *p = data + strlen(data) + 1;
+
+    for (size_t i = 0; i < argc - 1; i++, p += strlen(p) + 1) {
+        args[i] = p;
+    }
+
+    args[argc - 1] = NULL;
+
+    /* the received descriptors are close-on-exec, as the socket is */
+    execv(data, args);
+
+    int err = errno;
+
+    send(sock, &err, sizeof(err), 0);
+    _exit(EXIT_FAILURE);
+}
+
+
+/* forks one more helper into the pool; false if that failed */
+static bool add_helper() {
+    int socks[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, socks) == -1) {
+        return false;
+    }
+
+    uint64_t start = now_ns();
+    pid_t pid = fork();
+
+    if (pid > 0) count_time(STAT_FORK, start);
+
+    if (pid == -1) {
+        close(socks[0]);
+        close(socks[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        run_helper(socks[1]);
+    }
+
+    close(socks[1]);
+
+    pool.idle[pool.num].pid = pid;
+    pool.idle[pool.num].sock = socks[0];
+    pool.num++;
+
+    return true;
+}
+
+
+bool init_helpers(size_t num) {
+    pool.idle = malloc(sizeof(helper_t) * num);
+
+    if (pool.idle == NULL) {
+        /* malloc failed */
+        return false;
+    }
+
+    pool.size = num;
+    pool.owner = getpid();
+
+    refill_helpers();
+
+    return pool.num > 0;
+}
+
+
+void refill_helpers() {
+    if (pool.owner != getpid()) return;
+
+    while (pool.num < pool.size && add_helper());
+}
+
+
+/* lets a helper that never got a command go */
+static void drop_helper(helper_t *helper) {
+    /* the helper reads the closed socket as its cue to exit */
+    close(helper->sock);
+    while (waitpid(helper->pid, NULL, 0) == -1 && errno == EINTR);
+}
+
+
+void reset_helpers() {
+    if (pool.owner != getpid()) return;
+
+    for (; pool.num > 0; pool.num--) {
+        drop_helper(&pool.idle[pool.num - 1]);
+    }
+}
+
+
+/* sends a helper its command; false if it couldn't be sent */
+static bool send_command(int sock, char *exec_path, char **args, int fds[NUM_FDS]) {
+    size_t len = strlen(exec_path) + 1;
+
+    for (char **arg = args; *arg != NULL; arg++) {
+        len += strlen(*arg) + 1;
+    }
+
+    char *data = malloc(len);
+
+    if (data == NULL) {
+        /* malloc failed */
+        return false;
+    }
+
+    char *p = stpcpy(data, exec_path) + 1;
+
+    for (char **arg = args; *arg != NULL; arg++) {
+        p = stpcpy(p, *arg) + 1;
+    }
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * NUM_FDS)];
+        struct cmsghdr align;
+    } control;
+    struct iovec iov = { .iov_base = data, .iov_len = len };
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = control.buf, .msg_controllen = sizeof(control.buf)
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * NUM_FDS);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * NUM_FDS);
+
+    ssize_t sent;
+
+    while ((sent = sendmsg(sock, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR);
+
+    free(data);
+    return sent == (ssize_t) len;
+}
+
+
+pid_t launch_helper(char *exec_path, char **args, char *redir_file, int in_fd, int out_fd) {
+    if (pool.num == 0 || pool.owner != getpid()) return 0;
+
+    int redir_fd = -1;
+
+    if (redir_file != NULL &&
+        (redir_fd = open(redir_file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)) == -1) {
+        print_error();
+        return -1;
+    }
+
+    int fds[NUM_FDS] = {
+        (in_fd != -1) ? in_fd : STDIN_FILENO,
+        (out_fd != -1) ? out_fd : (redir_fd != -1) ? redir_fd : STDOUT_FILENO,
+        (redir_fd != -1) ? redir_fd : STDERR_FILENO
+    };
+
+    helper_t helper = pool.idle[--pool.num];
+    bool sent = send_command(helper.sock, exec_path, args, fds);
+
+    if (redir_fd != -1) close(redir_fd);
+
+    if (!sent) {
+        /* too long for a message, or the helper is gone */
+        drop_helper(&helper);
+        return 0;
+    }
+
+    /* nothing comes back if the exec works, just the end of the socket */
+    int err;
+    ssize_t n;
+
+    while ((n = recv(helper.sock, &err, sizeof(err), 0)) == -1 && errno == EINTR);
+
+    close(helper.sock);
+
+    if (n != 0) {
+        /* the exec failed, and the helper exits */
+        while (waitpid(helper.pid, NULL, 0) == -1 && errno == EINTR);
+        print_error();
+        return -1;
+    }
+
+    return helper.pid;
+}
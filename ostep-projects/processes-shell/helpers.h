@@ -0,0 +1,51 @@
+#ifndef HELPERS_H_
+#define HELPERS_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "structs.h"
+#include "error.h"
+#include "stats.h"
+
+
+/**
+ * Sets up a pool of num helpers, forked straight away. Returns false if
+ * not a single one could be forked.
+ **/
+bool init_helpers(size_t);
+
+
+/**
+ * Forks helpers until the pool is full again. Forking is what the helpers
+ * are there to save, so this is for when the shell is idle anyway, such as
+ * before it reads the next line.
+ **/
+void refill_helpers();
+
+
+/**
+ * Lets the idle helpers go. They were forked in the old working directory,
+ * so after a `cd` they have to be forked anew.
+ **/
+void reset_helpers();
+
+
+/**
+ * Hands an external command to an idle helper, which execs it with
+ * in_fd, out_fd and the redirect file (or the shell's own descriptors
+ * where those are -1 or NULL) as its standard input, output and error.
+ * Returns the process ID it runs as, once the exec has happened; -1, after
+ * printing an error, if the file couldn't be opened or the exec failed;
+ * and 0 if no helper took it, for the caller to start it some other way.
+ **/
+pid_t launch_helper(char*, char**, char*, int, int);
+
+#endif // HELPERS_H_
@@ -0,0 +1,323 @@
+#include "jobs.h"
+
+#define MAX_EVENTS 16           /* pidfds looked at per epoll_wait() */
+
+
+jobs_t *init_jobs() {
+    jobs_t *jobs = malloc(sizeof(jobs_t));
+
+    if (jobs == NULL) {
+        /* malloc failed */
+        return NULL;
+    }
+
+    jobs->head = NULL;
+    jobs->tail = NULL;
+    jobs->next_id = 1;
+
+    /* without epoll, processes are simply reaped with waitpid() */
+    jobs->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    return jobs;
+}
+
+
+static void free_job(job_t *job) {
+    for (size_t i = 0; i < job->num; i++) {
+        if (job->procs[i].pidfd != -1) close(job->procs[i].pidfd);
+    }
+
+    free(job->procs);
+    free(job->line);
+    free(job);
+}
+
+
+void free_jobs(jobs_t *jobs) {
+    if (jobs == NULL) return;
+
+    while (jobs->head != NULL) {
+        job_t *next = jobs->head->next;
+
+        free_job(jobs->head);
+        jobs->head = next;
+    }
+
+    if (jobs->epoll_fd != -1) close(jobs->epoll_fd);
+    free(jobs);
+}
+
+
+/* a job is removed once it's done; its time is counted, or printed for `time` */
+static void remove_job(jobs_t *jobs, job_t *job) {
+    count_command(job->start, job->end);
+    if (job->timed) print_times(job->end - job->start, &job->usage);
+
+    job_t *prev = NULL;
+
+    for (job_t **j = &jobs->head; *j != NULL; prev = *j, j = &(*j)->next) {
+        if (*j == job) {
+            *j = job->next;
+            break;
+        }
+    }
+
+    if (jobs->tail == job) jobs->tail = prev;
+
+    /* background jobs are numbered after the last one left; the list only
+     * holds unfinished jobs, so this is a short walk */
+    if (job->id != 0 && job->id == jobs->next_id - 1) {
+        jobs->next_id = 1;
+
+        for (job_t *j = jobs->head; j != NULL; j = j->next) {
+            if (j->id >= jobs->next_id) jobs->next_id = j->id + 1;
+        }
+    }
+
+    free_job(job);
+}
+
+
+/* marks a process reaped, and adds what it used to its job's share */
+static void proc_done(proc_t *proc, const struct rusage *usage) {
+    job_t *job = proc->job;
+
+    proc->done = true;
+    add_usage(&job->usage, usage);
+
+    if (--job->running == 0) job->end = now_ns();
+}
+
+
+/* collects a finished (or, if it has no pidfd, finishing) process */
+static void reap_proc(jobs_t *jobs, proc_t *proc) {
+    struct rusage usage = { 0 };
+
+    if (proc->pidfd != -1) {
+        /* epoll goes by open file, not by descriptor: while a copy of the
+         * pidfd is open anywhere (a child spawned since that hasn't reached
+         * its exec yet), closing ours alone would leave it in the set */
+        epoll_ctl(jobs->epoll_fd, EPOLL_CTL_DEL, proc->pidfd, NULL);
+        close(proc->pidfd);
+        proc->pidfd = -1;
+    }
+
+    while (wait4(proc->pid, &proc->status, 0, &usage) == -1 && errno == EINTR);
+
+    proc_done(proc, &usage);
+}
+
+
+/**
+ * Reaps the processes whose pidfds have become readable, that is, that
+ * have finished, waiting up to timeout milliseconds (-1 for no limit) for
+ * the first of them.
+ **/
+static void poll_jobs(jobs_t *jobs, int timeout) {
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(jobs->epoll_fd, events, MAX_EVENTS, timeout);
+
+    for (int i = 0; i < n; i++) {
+        reap_proc(jobs, events[i].data.ptr);
+    }
+}
+
+
+static job_t *add_job(jobs_t *jobs, pid_t *pids, size_t num, const char *line,
+                      bool background, uint64_t start, bool timed) {
+    job_t *job = malloc(sizeof(job_t));
+
+    if (job == NULL) {
+        /* malloc failed */
+        return NULL;
+    }
+
+    job->procs = calloc(num, sizeof(proc_t));
+    job->line = (line != NULL) ? strdup(line) : NULL;
+
+    if (job->procs == NULL || (line != NULL && job->line == NULL)) {
+        /* malloc failed */
+        free(job->procs);
+        free(job->line);
+        free(job);
+        return NULL;
+    }
+
+    job->num = num;
+    job->running = num;
+    job->background = background;
+    job->timed = timed;
+    job->start = start;
+    job->end = start;
+    memset(&job->usage, 0, sizeof(job->usage));
+    job->next = NULL;
+    job->id = 0;
+
+    for (size_t i = 0; i < num; i++) {
+        proc_t *proc = &job->procs[i];
+
+        proc->pid = pids[i];
+        proc->pidfd = -1;
+        proc->job = job;
+
+        if (jobs->epoll_fd == -1) continue;
+
+        /* the pidfd becomes readable when the process exits, even if that
+         * has happened already, as nothing else reaps it */
+        proc->pidfd = pidfd_open(proc->pid, 0);
+
+        if (proc->pidfd == -1) continue;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = proc };
+
+        if (epoll_ctl(jobs->epoll_fd, EPOLL_CTL_ADD, proc->pidfd, &ev) == -1) {
+            close(proc->pidfd);
+            proc->pidfd = -1;
+        }
+    }
+
+    /* background jobs are numbered after the last one; foreground jobs are
+     * never shown, so they keep ID 0 */
+    if (background) job->id = jobs->next_id++;
+
+    if (jobs->tail != NULL) {
+        jobs->tail->next = job;
+    } else {
+        jobs->head = job;
+    }
+
+    jobs->tail = job;
+    return job;
+}
+
+
+int run_job(jobs_t *jobs, pid_t *pids, size_t num, const char *line, bool background,
+            uint64_t start, bool timed) {
+    if (num == 0) return 0;
+
+    job_t *job = add_job(jobs, pids, num, line, background, start, timed);
+
+    if (job == NULL) {
+        /* no room to remember the job; wait for it here and now */
+        print_error();
+
+        for (size_t i = 0; i < num; i++) {
+            waitpid(pids[i], NULL, 0);
+        }
+        return 0;
+    }
+
+    if (!background) {
+        wait_job(jobs, job);
+        return 0;
+    }
+
+    return job->id;
+}
+
+
+void reap_jobs(jobs_t *jobs, bool notify) {
+    if (jobs->epoll_fd != -1) poll_jobs(jobs, 0);
+
+    for (job_t *job = jobs->head, *next; job != NULL; job = next) {
+        next = job->next;
+
+        for (size_t i = 0; i < job->num; i++) {
+            proc_t *proc = &job->procs[i];
+            struct rusage usage = { 0 };
+
+            if (!proc->done && proc->pidfd == -1 &&
+                wait4(proc->pid, &proc->status, WNOHANG, &usage) == proc->pid) {
+                proc_done(proc, &usage);
+            }
+        }
+
+        if (job->background && job->running == 0) {
+            if (notify) printf("[%d] Done\t%s\n", job->id, job->line);
+            remove_job(jobs, job);
+        }
+    }
+}
+
+
+job_t *find_job(jobs_t *jobs, int id) {
+    for (job_t *job = jobs->head; job != NULL; job = job->next) {
+        if (job->background && job->id == id) return job;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Blocks until at least one more process is reaped: one of the given job's
+ * (or any job's, if NULL) that has no pidfd to watch it by, or else
+ * whichever watched process finishes first, whatever job it belongs to.
+ **/
+static void reap_next(jobs_t *jobs, job_t *job) {
+    for (job_t *j = (job != NULL) ? job : jobs->head; j != NULL; j = (job != NULL) ? NULL : j->next) {
+        for (size_t i = 0; i < j->num; i++) {
+            if (!j->procs[i].done && j->procs[i].pidfd == -1) {
+                reap_proc(jobs, &j->procs[i]);
+                return;
+            }
+        }
+    }
+
+    poll_jobs(jobs, -1);
+}
+
+
+void wait_job(jobs_t *jobs, job_t *job) {
+    uint64_t start = now_ns();
+
+    while (job->running > 0) {
+        reap_next(jobs, job);
+    }
+
+    count_time(STAT_WAIT, start);
+
+    remove_job(jobs, job);
+}
+
+
+job_t *wait_next_job(jobs_t *jobs) {
+    uint64_t start = now_ns();
+
+    while (jobs->head != NULL) {
+        for (job_t *job = jobs->head; job != NULL; job = job->next) {
+            if (!job->background || job->running > 0) continue;
+
+            count_time(STAT_WAIT, start);
+            return job;
+        }
+
+        reap_next(jobs, NULL);
+    }
+
+    return NULL;
+}
+
+
+void wait_all_jobs(jobs_t *jobs) {
+    while (jobs->head != NULL) {
+        wait_job(jobs, jobs->head);
+    }
+}
+
+
+void list_jobs(jobs_t *jobs) {
+    reap_jobs(jobs, false);
+
+    for (job_t *job = jobs->head, *next; job != NULL; job = next) {
+        next = job->next;
+
+        if (!job->background) continue;
+
+        printf("[%d] %s\t%s\n", job->id, (job->running > 0) ? "Running" : "Done", job->line);
+
+        if (job->running == 0) remove_job(jobs, job);
+    }
+
+    fflush(stdout);
+}
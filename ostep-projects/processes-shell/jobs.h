@@ -0,0 +1,69 @@
+#ifndef JOBS_H_
+#define JOBS_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/pidfd.h>
+
+#include "structs.h"
+#include "error.h"
+#include "stats.h"
+
+
+/* creates an empty job table */
+jobs_t *init_jobs();
+
+
+/* frees the job table; any jobs still running are left to run */
+void free_jobs(jobs_t*);
+
+
+/**
+ * Adds the processes started for a command line to the job table as one
+ * job. A foreground job is waited for before this returns; a background
+ * job is left running, and line (which may be NULL for foreground jobs) is
+ * kept to show it by. start is when the line started (from now_ns()), and
+ * a timed job has its times printed once it's done. Returns the number of
+ * a background job, or 0.
+ **/
+int run_job(jobs_t*, pid_t*, size_t, const char*, bool, uint64_t, bool);
+
+
+/**
+ * Reaps whichever processes have finished, without blocking, and drops
+ * finished background jobs from the table. With notify set, they are
+ * reported as they go.
+ **/
+void reap_jobs(jobs_t*, bool);
+
+
+/* finds a background job by its ID; NULL if there's no such job */
+job_t *find_job(jobs_t*, int);
+
+
+/* waits for a job to finish and drops it from the table */
+void wait_job(jobs_t*, job_t*);
+
+
+/**
+ * Waits until a background job has finished, and returns it, still in the
+ * table (wait_job() drops it). Returns NULL if there are no jobs at all.
+ **/
+job_t *wait_next_job(jobs_t*);
+
+
+/* waits for every background job to finish */
+void wait_all_jobs(jobs_t*);
+
+
+/* prints the background jobs; the finished ones are then dropped */
+void list_jobs(jobs_t*);
+
+#endif // JOBS_H_
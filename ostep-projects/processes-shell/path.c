@@ -1,6 +1,49 @@
 #include "path.h"
 #include "structs.h"
 
+#define INITIAL_TABLE_SIZE 64   /* buckets in a new command hash table */
+
+
+/* clears the lookup state of a path that's just been made */
+static void init_lookup(path_t *p) {
+    p->dirs = NULL;
+    p->table = NULL;
+    p->table_size = 0;
+    p->hashed = 0;
+}
+
+
+/* opens (or reopens) a path directory; one that can't be opened is tried again on the next lookup */
+static void open_dir(path_t *p, size_t i) {
+    if (p->dirs[i] != -1) close(p->dirs[i]);
+
+    p->dirs[i] = open(p->paths[i], O_PATH | O_DIRECTORY | O_CLOEXEC);
+}
+
+
+/**
+ * Opens every path directory once, so that looking for a command is a single
+ * faccessat() per directory instead of building and checking a full path
+ * string each time. Returns false if malloc failed.
+ **/
+static bool open_dirs(path_t *p) {
+    if (p->num == 0) return true;
+
+    p->dirs = malloc(sizeof(int) * p->num);
+
+    if (p->dirs == NULL) {
+        /* malloc failed */
+        return false;
+    }
+
+    for (size_t i = 0; i < p->num; i++) {
+        p->dirs[i] = -1;
+        open_dir(p, i);
+    }
+
+    return true;
+}
+
 path_t *init_default_path() {
     /* default path includes only '/bin' */
     path_t *p;
@@ -11,6 +54,8 @@ path_t *init_default_path() {
         return NULL;
     }
 
+    init_lookup(p);
+
     char *def_p = "/bin";
     size_t def_len = strlen(def_p);
     size_t def_p_num = 1;
@@ -34,6 +79,12 @@ path_t *init_default_path() {
     *p->paths = def_path_string;
     p->num = def_p_num;
 
+    if (!open_dirs(p)) {
+        /* malloc failed */
+        free_path(p);
+        return NULL;
+    }
+
     return p;
 }
 
@@ -47,6 +98,16 @@ void free_path(path_t *p) {
         }
         free(p->paths);
     }
+
+    if (p->dirs != NULL) {
+        for (int i = 0; i < p->num; i++) {
+            if (p->dirs[i] != -1) close(p->dirs[i]);
+        }
+        free(p->dirs);
+    }
+
+    forget_commands(p);
+    free(p->table);
     free(p);
     return;
 }
@@ -61,6 +122,8 @@ path_t *add_paths(command_t *cmd) {
         return NULL;
     }
 
+    init_lookup(new_p);
+
     new_p->num = 0;
 
     /* copy paths to this new path */
@@ -103,9 +166,9 @@ path_t *add_paths(command_t *cmd) {
 
             cpy[0] = '.';
             cpy[1] = '/';
-            cpy[3] = '\0';
+            cpy[2] = '\0';
 
-            strncat(cpy, curr, strlen(curr) + 3);
+            strcat(cpy, curr);
         }
 
         new_p->paths[i] = cpy;
@@ -118,10 +181,169 @@ path_t *add_paths(command_t *cmd) {
         return NULL;
     }
 
+    if (!open_dirs(new_p)) {
+        /* malloc failed */
+        free_path(new_p);
+        return NULL;
+    }
+
     return new_p;
 }
 
 
+/* FNV-1a hash of a command name */
+static size_t hash_name(const char *name) {
+    size_t h = 14695981039346656037UL;
+
+    for (; *name != '\0'; name++) {
+        h ^= (unsigned char) *name;
+        h *= 1099511628211UL;
+    }
+
+    return h;
+}
+
+
+/* removes a command from the table and frees it */
+static void unhash(path_t *p, hashed_t **link) {
+    hashed_t *entry = *link;
+
+    *link = entry->next;
+    free(entry->name);
+    free(entry->full_path);
+    free(entry);
+    p->hashed--;
+}
+
+
+/* doubles the number of buckets once there are more commands than buckets */
+static void grow_table(path_t *p) {
+    size_t size = (p->table_size == 0) ? INITIAL_TABLE_SIZE : p->table_size * 2;
+    hashed_t **table = calloc(size, sizeof(hashed_t *));
+
+    if (table == NULL) {
+        /* calloc failed; keep using the table as it is */
+        return;
+    }
+
+    for (size_t b = 0; b < p->table_size; b++) {
+        hashed_t *entry = p->table[b];
+
+        while (entry != NULL) {
+            hashed_t *next = entry->next;
+            size_t slot = hash_name(entry->name) & (size - 1);
+
+            entry->next = table[slot];
+            table[slot] = entry;
+            entry = next;
+        }
+    }
+
+    free(p->table);
+    p->table = table;
+    p->table_size = size;
+}
+
+
+/* remembers where a command was found; returns its full path, or NULL if malloc failed */
+static char *hash_command(path_t *p, const char *name, size_t dir) {
+    if (p->hashed >= p->table_size) grow_table(p);
+
+    if (p->table_size == 0) {
+        /* calloc failed */
+        return NULL;
+    }
+
+    hashed_t *entry = malloc(sizeof(hashed_t));
+
+    if (entry == NULL) {
+        /* malloc failed */
+        return NULL;
+    }
+
+    /* build the full path once, for execv() */
+    size_t p_len = strlen(p->paths[dir]);
+    size_t n_len = strlen(name);
+
+    entry->name = strdup(name);
+    entry->full_path = malloc(p_len + n_len + 2);
+
+    if (entry->name == NULL || entry->full_path == NULL) {
+        /* malloc failed */
+        free(entry->name);
+        free(entry->full_path);
+        free(entry);
+        return NULL;
+    }
+
+    memcpy(entry->full_path, p->paths[dir], p_len);
+    entry->full_path[p_len] = '/';
+    memcpy(entry->full_path + p_len + 1, name, n_len + 1);
+
+    size_t slot = hash_name(name) & (p->table_size - 1);
+
+    entry->dir = dir;
+    entry->next = p->table[slot];
+    p->table[slot] = entry;
+    p->hashed++;
+
+    return entry->full_path;
+}
+
+
+char *find_command(path_t *p, const char *name) {
+    if (p->table_size > 0) {
+        hashed_t **link = &p->table[hash_name(name) & (p->table_size - 1)];
+
+        for (; *link != NULL; link = &(*link)->next) {
+            hashed_t *entry = *link;
+
+            if (strcmp(entry->name, name) != 0) continue;
+
+            /* make sure it's still there, as bash does */
+            if (faccessat(p->dirs[entry->dir], name, X_OK, 0) == 0) {
+                return entry->full_path;
+            }
+
+            unhash(p, link);
+            break;
+        }
+    }
+
+    /* search each path directory in order; one that couldn't be opened
+     * before may have been created since, as access() would see */
+    for (size_t i = 0; i < p->num; i++) {
+        if (p->dirs[i] == -1) open_dir(p, i);
+        if (p->dirs[i] == -1) continue;
+
+        if (faccessat(p->dirs[i], name, X_OK, 0) == 0) {
+            return hash_command(p, name, i);
+        }
+    }
+
+    return NULL;
+}
+
+
+void forget_commands(path_t *p) {
+    for (size_t b = 0; b < p->table_size; b++) {
+        while (p->table[b] != NULL) {
+            unhash(p, &p->table[b]);
+        }
+    }
+}
+
+
+void path_cwd_changed(path_t *p) {
+    /* relative paths now point somewhere else */
+    for (size_t i = 0; i < p->num; i++) {
+        if (p->paths[i][0] != '/') open_dir(p, i);
+    }
+
+    forget_commands(p);
+}
+
+
 /* print a given path variable's contents for debugging */
 void print_paths(path_t *path) {
     printf("Path num: %ld\nPaths: ", path->num);
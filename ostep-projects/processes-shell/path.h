@@ -5,6 +5,8 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "structs.h"
 
 
@@ -26,6 +28,26 @@ void free_path(path_t*);
 path_t *add_paths(command_t*);
 
 
+/**
+ * Looks for an executable command on the path and returns its full path, or
+ * NULL if it can't be found. Commands are hashed as they are found, so
+ * running the same command again costs a single check that it's still
+ * there. The returned string belongs to the path.
+ **/
+char *find_command(path_t*, const char*);
+
+
+/* empties the path's command hash table */
+void forget_commands(path_t*);
+
+
+/**
+ * Lets the path know the working directory changed: relative path
+ * directories are opened again, and the commands found so far forgotten.
+ **/
+void path_cwd_changed(path_t*);
+
+
 /* print a given path variable's contents for debugging */
 void print_paths(path_t*);
 
@@ -0,0 +1,96 @@
+#include "stats.h"
+
+#define NUM_BUCKETS 64          /* latency buckets: 0-1, 2-3, 4-7, ... microseconds */
+
+/* everything wish --stats keeps count of */
+typedef struct {
+    pid_t owner;                /* the shell; 0 unless stats are kept */
+    uint64_t commands;          /* commands that have finished */
+    uint64_t buckets[NUM_BUCKETS];  /* commands by floor(log2(microseconds)) */
+    uint64_t calls[NUM_STATS];  /* forks, execs and waits */
+    uint64_t total[NUM_STATS];  /* nanoseconds spent on each */
+} stats_t;
+
+static stats_t stats;
+
+static const char *stat_names[NUM_STATS] = { "fork", "exec", "wait" };
+
+
+uint64_t now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * (uint64_t) 1000000000 + ts.tv_nsec;
+}
+
+
+static void print_stats() {
+    /* children forked since share the handler, but not the counts */
+    if (stats.owner != getpid()) return;
+
+    fprintf(stderr, "commands: %lu\n", (unsigned long) stats.commands);
+    fprintf(stderr, "latency (us):\n");
+
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        if (stats.buckets[b] == 0) continue;
+
+        uint64_t low = (b == 0) ? 0 : (uint64_t) 1 << b;
+        uint64_t high = ((uint64_t) 1 << b) * 2 - 1;
+        char range[48];
+
+        snprintf(range, sizeof(range), "%lu-%lu", (unsigned long) low, (unsigned long) high);
+        fprintf(stderr, "  %-24s %lu\n", range, (unsigned long) stats.buckets[b]);
+    }
+
+    for (int i = 0; i < NUM_STATS; i++) {
+        fprintf(stderr, "%s: %lu in %.3f ms\n", stat_names[i], (unsigned long) stats.calls[i],
+                stats.total[i] / 1e6);
+    }
+}
+
+
+void init_stats() {
+    stats.owner = getpid();
+    atexit(print_stats);
+}
+
+
+void count_time(stat_kind kind, uint64_t start) {
+    if (stats.owner == 0) return;
+
+    stats.calls[kind]++;
+    stats.total[kind] += now_ns() - start;
+}
+
+
+void count_command(uint64_t start, uint64_t end) {
+    if (stats.owner == 0) return;
+
+    uint64_t us = (end - start) / 1000;
+
+    stats.commands++;
+    stats.buckets[63 - __builtin_clzll(us | 1)]++;
+}
+
+
+void add_usage(struct rusage *total, const struct rusage *usage) {
+    timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+
+    /* the processes ran side by side, or one after another; either way,
+     * the most any one of them had is what's known */
+    if (usage->ru_maxrss > total->ru_maxrss) total->ru_maxrss = usage->ru_maxrss;
+
+    total->ru_nvcsw += usage->ru_nvcsw;
+    total->ru_nivcsw += usage->ru_nivcsw;
+}
+
+
+void print_times(uint64_t wall, const struct rusage *usage) {
+    fprintf(stderr, "real %.3fs  user %.3fs  sys %.3fs  maxrss %ld KiB  "
+            "ctxsw %ld voluntary, %ld involuntary\n",
+            wall / 1e9,
+            usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6,
+            usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6,
+            usage->ru_maxrss, usage->ru_nvcsw, usage->ru_nivcsw);
+}
@@ -0,0 +1,54 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+
+/* what the shell's time goes on, as wish --stats adds it up */
+typedef enum {
+    STAT_FORK,                  /* fork(), for children that don't exec */
+    STAT_EXEC,                  /* getting an external command exec'd */
+    STAT_WAIT,                  /* waiting for commands to finish */
+    NUM_STATS
+} stat_kind;
+
+
+/* the monotonic clock, in nanoseconds */
+uint64_t now_ns();
+
+
+/**
+ * Starts keeping stats (wish --stats), to be printed to standard error
+ * when the shell exits.
+ **/
+void init_stats();
+
+
+/* adds the time since start (from now_ns()) to one of the totals */
+void count_time(stat_kind, uint64_t);
+
+
+/* adds a command that ran from start to end to the latency histogram */
+void count_command(uint64_t, uint64_t);
+
+
+/* adds the resources a process used to those of the others */
+void add_usage(struct rusage*, const struct rusage*);
+
+
+/**
+ * The `time` report for a command: the wall-clock time it took, then the
+ * user and system time, largest resident set, and context switches from
+ * its rusage. Printed to standard error.
+ **/
+void print_times(uint64_t, const struct rusage*);
+
+#endif // STATS_H_
@@ -2,6 +2,11 @@
 #define STRUCTS_H_
 
 #include<stdlib.h>
+#include<stddef.h>
+#include<stdbool.h>
+#include<stdint.h>
+#include<sys/types.h>
+#include<sys/resource.h>
 
 typedef struct {
     char **tokens;
@@ -9,11 +14,49 @@ typedef struct {
 } tokens_t;
 
 /**
- * Struct holds the number of paths and all path strings.
+ * A block of memory that an arena hands out in pieces.
+ **/
+typedef struct chunk_t {
+    struct chunk_t *next;       /* the next, bigger block */
+    size_t size;                /* bytes in data */
+    size_t used;                /* bytes handed out so far */
+    _Alignas(max_align_t) char data[];
+} chunk_t;
+
+/**
+ * A bump allocator for everything parsed from a single line: the pieces are
+ * never freed one by one, the whole arena is reset once the line is done.
+ * The blocks are kept for the next line, so after the first few lines
+ * parsing doesn't call malloc() at all.
+ **/
+typedef struct {
+    chunk_t *first;             /* blocks, from the first allocated */
+    chunk_t *current;           /* block pieces are being taken from */
+} arena_t;
+
+/**
+ * A command that was found on the path, remembered so that the next time it
+ * is run the path doesn't have to be searched again.
+ **/
+typedef struct hashed_t {
+    char *name;                 /* the command as typed */
+    char *full_path;            /* where it was found */
+    size_t dir;                 /* index of the path it was found in */
+    struct hashed_t *next;      /* next command in the same bucket */
+} hashed_t;
+
+/**
+ * Struct holds the number of paths and all path strings, along with an open
+ * descriptor for each path directory and a hash table of the commands
+ * already found in them. Setting a new path starts with a new, empty table.
  **/
 typedef struct {
     char **paths;               /* the path pointer array */
     size_t num;                 /* number of paths in array */
+    int *dirs;                  /* O_PATH descriptor of each path, or -1 */
+    hashed_t **table;           /* hash table of commands found so far */
+    size_t table_size;          /* number of buckets in the table */
+    size_t hashed;              /* number of commands in the table */
 } path_t;
 
 /**
@@ -23,6 +66,9 @@ typedef enum {
     CMD_EXIT,                   /* exits shell */
     CMD_CD,                     /* changes working directory */
     CMD_PATH,                   /* changes shell path variable */
+    CMD_JOBS,                   /* lists background jobs */
+    CMD_WAIT,                   /* waits for background jobs */
+    CMD_UTILITY,                /* cat, echo, ...: built in, but run like external ones */
     CMD_EXTERNAL                /* external command */
 } command_type;
 
@@ -31,8 +77,8 @@ typedef enum {
  * Struct defines a shell command with command type, the argument strings
  * associated with it, and the number of arguments themselves.
  *
- * For external commands, the command itself is included at the first position
- * within the arguments.
+ * For external commands and utilities, the command itself is included at the
+ * first position within the arguments.
  **/
 typedef struct {
     command_type typ;           /* the type of command: external or internal */
@@ -40,5 +86,81 @@ typedef struct {
     char **args;                /* the args themselves */
 } command_t;
 
+/**
+ * Struct holds a command of a line once it has been parsed and looked up,
+ * ready to be started: the stages of a pipeline, or just the one command.
+ **/
+typedef struct {
+    command_t **cmds;           /* the commands, one per stage */
+    char **exec_paths;          /* where each was found; NULL if built in */
+    size_t num;                 /* number of stages */
+    char *redir_file;           /* where the last stage's output goes, or NULL */
+    bool timed;                 /* whether it came after `time` */
+} plan_t;
+
+
+/**
+ * A process started by the shell, watched through a pidfd so that it can be
+ * reaped whenever it finishes, in whatever order.
+ **/
+typedef struct {
+    pid_t pid;                  /* the process ID */
+    int pidfd;                  /* pidfd_open() descriptor, or -1 if none */
+    int status;                 /* wait status, once done */
+    bool done;                  /* whether it has been reaped */
+    struct job_t *job;          /* the job it belongs to */
+} proc_t;
+
+/**
+ * Struct holds the processes started by a single command line. A line
+ * ending in '&' is a background job and the prompt comes back right away;
+ * any other line is waited for before the next one is read.
+ **/
+typedef struct job_t {
+    int id;                     /* job number, as `jobs` and `wait` show it */
+    char *line;                 /* the command line, for `jobs` */
+    proc_t *procs;              /* its processes */
+    size_t num;                 /* number of processes */
+    size_t running;             /* number not reaped yet */
+    bool background;            /* whether the line ended in '&' */
+    bool timed;                 /* whether to print its times once it's done */
+    uint64_t start;             /* when it was started, from now_ns() */
+    uint64_t end;               /* when its last process was reaped */
+    struct rusage usage;        /* what its processes used, added up */
+    struct job_t *next;         /* next job, in order of ID */
+} job_t;
+
+/**
+ * The shell's job table, along with the epoll instance all the pidfds are
+ * registered with.
+ **/
+typedef struct {
+    job_t *head;                /* list of jobs, in order of ID */
+    job_t *tail;                /* last job in the list, where new ones go */
+    int next_id;                /* ID for the next background job */
+    int epoll_fd;               /* epoll descriptor, or -1 if unavailable */
+} jobs_t;
+
+/**
+ * A process forked ahead of time (wish -z N) that waits, doing nothing, to
+ * be handed a command to exec, so that starting the command costs a
+ * message rather than a fork.
+ **/
+typedef struct {
+    pid_t pid;                  /* the helper's process ID */
+    int sock;                   /* the shell's end of the socketpair to it */
+} helper_t;
+
+/**
+ * The idle helpers. Only the process that forked them (the shell, not any
+ * child forked since) can hand them commands, since only it can wait for
+ * them once they have become those commands.
+ **/
+typedef struct {
+    helper_t *idle;             /* the helpers waiting for a command */
+    size_t num;                 /* number of idle helpers */
+    size_t size;                /* how many the pool is kept filled to */
+    pid_t owner;                /* the process that forked them */
+} helpers_t;
 
 #endif // STRUCTS_H_
@@ -3,80 +3,85 @@
 #include <stdio.h>
 #include <stdbool.h>
 
-void free_tokens(tokens_t *t) {
-    if (t == NULL) return;
+/**
+ * Cuts a line in place at every sep character, skipping empty pieces unless
+ * keep_empty is set (then an empty piece is a NULL token). The tokens point
+ * into the line, and only the token array comes from the arena.
+ **/
+static tokens_t *slice_line(char *line, char sep, bool keep_empty, arena_t *arena) {
+    size_t max = 1;
+
+    for (char *c = line; (c = strchr(c, sep)) != NULL; c++) {
+        max++;
+    }
 
-    if (t->tokens != NULL) {
-        for (int i = 0; i < t->num; i++) {
-            if (t->tokens[i] == NULL) continue;
-            free(t->tokens[i]);
-        }
-        free(t->tokens);
+    tokens_t *tkn = arena_alloc(arena, sizeof(tokens_t));
+    char **tokens = arena_alloc(arena, sizeof(char *) * max);
+
+    if (tkn == NULL || tokens == NULL) {
+        /* malloc failed */
+        return NULL;
     }
-    free(t);
-}
 
-tokens_t *tokenize_line(char **lineptr, size_t line_size) {
-    tokens_t *tkn;
-    char *token, *saveptr;
+    tkn->tokens = tokens;
+    tkn->num = 0;
 
-    const char* DELIMITER = "&";
+    for (char *piece = line; piece != NULL; ) {
+        char *next = strchr(piece, sep);
 
-    token = strtok_r(*lineptr, DELIMITER, &saveptr);
+        if (next != NULL) *next++ = '\0';
 
-    if (token == NULL) {
-        /* line is empty */
-        return NULL;
+        if (*piece != '\0') {
+            tkn->tokens[tkn->num++] = piece;
+        } else if (keep_empty) {
+            tkn->tokens[tkn->num++] = NULL;
+        }
+
+        piece = next;
     }
 
-    tkn = malloc(sizeof(tokens_t));
+    return tkn;
+}
+
 
-    if (tkn == NULL) {
-        /* malloc failed */
+tokens_t *tokenize_line(char *line, arena_t *arena) {
+    tokens_t *tkn = slice_line(line, '&', false, arena);
+
+    if (tkn == NULL || tkn->num == 0) {
+        /* line is empty, or malloc failed */
         return NULL;
     }
 
-    tkn->num = 1;
-    tkn->tokens = malloc(sizeof(tkn->tokens) * tkn->num);
+    return tkn;
+}
+
 
-    if (tkn->tokens == NULL) {
+tokens_t *split_pipeline(char *line, arena_t *arena) {
+    tokens_t *tkn = slice_line(line, '|', true, arena);
+
+    if (tkn == NULL) {
         /* malloc failed */
-        free(tkn);
         return NULL;
     }
 
-    tkn->tokens[0] = malloc(sizeof(char) * (strlen(token) + 1));
-    strncpy(tkn->tokens[0], token, strlen(token) + 1);
-
-    /* look for the rest of the tokens */
-    while ((token = strtok_r(NULL, DELIMITER, &saveptr)) != NULL) {
-        /* for every new token found */
-        /* allocate space for the token pointer */
-        char **tmp = realloc(tkn->tokens, sizeof(tkn->tokens) * (tkn->num + 1));
-
-        if (tmp == NULL) {
-            /* realloc failed */
-            free_tokens(tkn);
+    /* unlike with '&', an empty stage ("ls |", "ls || wc") is an error */
+    for (size_t i = 0; i < tkn->num; i++) {
+        if (tkn->tokens[i] == NULL || tkn->tokens[i][strspn(tkn->tokens[i], WHITESPACE)] == '\0') {
+            /* stage is empty or all whitespace */
             return NULL;
         }
+    }
 
-        tkn->tokens = tmp;
-
-        char *extracted_tk = malloc(sizeof(char) * (strlen(token) + 1));
+    return tkn;
+}
 
-        if (extracted_tk == NULL) {
-            /* malloc failed */
-            free_tokens(tkn);
-            return NULL;
-        }
 
-        strncpy(extracted_tk, token, strlen(token) + 1);
+bool is_background(const char *line) {
+    size_t len = strlen(line);
 
-        tkn->tokens[tkn->num] = extracted_tk;
-        tkn->num++;
-    }
+    while (len > 0 && strchr(WHITESPACE, line[len - 1]) != NULL) len--;
 
-    return tkn;
+    return len > 0 && line[len - 1] == '&';
 }
 
 
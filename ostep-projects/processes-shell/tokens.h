@@ -8,10 +8,24 @@
 
 #include "structs.h"
 #include "error.h"
+#include "arena.h"
 
-void free_tokens(tokens_t*);
+/**
+ * Splits a command line at each '&' into the commands to run in parallel.
+ * The line is cut up in place: the tokens point into it, and only the
+ * token array is taken from the arena. Returns NULL if there are no
+ * commands in the line (or malloc failed).
+ **/
+tokens_t *tokenize_line(char*, arena_t*);
 
-tokens_t *tokenize_line(char **, size_t);
+/**
+ * Splits a command at each '|', in place, into the stages of a pipeline.
+ * Returns NULL if any stage is empty, or if malloc failed.
+ **/
+tokens_t *split_pipeline(char*, arena_t*);
+
+/* whether a command line ends in '&', i.e. is meant to run in the background */
+bool is_background(const char*);
 
 int parse_redirect(char*, char**);
 
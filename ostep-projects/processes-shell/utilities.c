@@ -0,0 +1,219 @@
+#include "utilities.h"
+
+#define BUFFER_SIZE (128 << 10)     /* read()/write() size for the fallback */
+#define KERNEL_CHUNK (1 << 30)      /* bytes asked of the kernel per call */
+
+/**
+ * How cat gets the data from a file to standard output. This is wcat's copy
+ * code (initial-utilities/wcat), copied rather than shared: each project
+ * builds on its own, from its own directory.
+ **/
+typedef enum {
+    COPY_RANGE,     /* copy_file_range(): file to file, possibly just extents */
+    COPY_SPLICE,    /* splice(): anything into a pipe, through its pages */
+    COPY_SENDFILE,  /* sendfile(): a file's page cache to a socket or file */
+    COPY_BUFFER     /* read() and write() through a buffer of our own */
+} method_t;
+
+/* a utility, by the name it is run by */
+typedef struct {
+    const char *name;
+    utility_t run;
+} entry_t;
+
+
+/* picks the fastest way to copy a file to stdout that is worth a try */
+static method_t choose_method(const struct stat *in, const struct stat *out) {
+    /**
+     * A regular file with no size may still have data (files in /proc and
+     * /sys), which only read() is sure to return.
+     **/
+    bool in_file = S_ISREG(in->st_mode) && in->st_size > 0;
+    bool in_stream = S_ISFIFO(in->st_mode) || S_ISSOCK(in->st_mode);
+
+    if (S_ISFIFO(out->st_mode) && (in_file || in_stream)) return COPY_SPLICE;
+    if (in_file && S_ISREG(out->st_mode)) return COPY_RANGE;
+    if (in_file) return COPY_SENDFILE;
+
+    return COPY_BUFFER;
+}
+
+
+/**
+ * Moves data from fd to stdout without it passing through user space.
+ * Returns 1 once it's all copied, 0 if the kernel can't do that for this
+ * pair of descriptors, and -1 on an error. Whatever was copied by then has
+ * moved both file offsets along, so the fallback carries on where this
+ * left off.
+ **/
+static int copy_kernel(int fd, method_t method) {
+    bool first = true;
+    ssize_t n;
+
+    do {
+        switch (method) {
+            case COPY_RANGE:
+                n = copy_file_range(fd, NULL, STDOUT_FILENO, NULL, KERNEL_CHUNK, 0);
+                break;
+
+            case COPY_SPLICE:
+                n = splice(fd, NULL, STDOUT_FILENO, NULL, KERNEL_CHUNK, SPLICE_F_MOVE);
+                break;
+
+            default:
+                n = sendfile(STDOUT_FILENO, fd, NULL, KERNEL_CHUNK);
+                break;
+        }
+
+        if (n == -1) {
+            if (errno == EINTR) continue;
+
+            /* unsupported for these files (e.g. across file systems) */
+            if (first && (errno == EINVAL || errno == EXDEV || errno == ENOSYS ||
+                          errno == EOPNOTSUPP || errno == EBADF)) {
+                return 0;
+            }
+
+            return -1;
+        }
+
+        first = false;
+    } while (n != 0);
+
+    return 1;
+}
+
+
+/* copies fd to stdout through a buffer; false on an error */
+static bool copy_buffer(int fd) {
+    static char buffer[BUFFER_SIZE];
+    ssize_t n;
+
+    while ((n = read(fd, buffer, BUFFER_SIZE)) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        for (ssize_t done = 0; done < n; ) {
+            ssize_t written = write(STDOUT_FILENO, buffer + done, n - done);
+
+            if (written == -1) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+
+            done += written;
+        }
+    }
+
+    return true;
+}
+
+
+/* copies a file (or, for "-", standard input) to standard output */
+static bool cat_file(const char *name, const struct stat *out_stat) {
+    bool is_stdin = (strcmp(name, "-") == 0);
+    int fd = is_stdin ? STDIN_FILENO : open(name, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) return false;
+
+    struct stat in_stat;
+    method_t method = COPY_BUFFER;
+
+    if (out_stat != NULL && fstat(fd, &in_stat) == 0) {
+        method = choose_method(&in_stat, out_stat);
+    }
+
+    int copied = (method == COPY_BUFFER) ? 0 : copy_kernel(fd, method);
+    bool ok = (copied == 1) || (copied == 0 && copy_buffer(fd));
+
+    if (!is_stdin && close(fd) != 0) ok = false;
+
+    return ok;
+}
+
+
+/**
+ * cat [file ...]: the files one after the other, each copied the way wcat
+ * copies it. A file that can't be read is reported and skipped; with no
+ * files, standard input is copied.
+ **/
+static int utility_cat(int argc, char *argv[]) {
+    struct stat out_stat;
+    bool out_known = (fstat(STDOUT_FILENO, &out_stat) == 0);
+    int status = EXIT_SUCCESS;
+
+    if (argc == 1) {
+        return cat_file("-", out_known ? &out_stat : NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (!cat_file(argv[i], out_known ? &out_stat : NULL)) {
+            fprintf(stderr, "cat: %s: %s\n", argv[i], strerror(errno));
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+
+/* echo [-n] [arg ...]: the args, separated by spaces; -n leaves out the newline */
+static int utility_echo(int argc, char *argv[]) {
+    bool newline = true;
+    int i = 1;
+
+    if (argc > 1 && strcmp(argv[1], "-n") == 0) {
+        newline = false;
+        i++;
+    }
+
+    for (int first = i; i < argc; i++) {
+        if (i > first) putchar(' ');
+        fputs(argv[i], stdout);
+    }
+
+    if (newline) putchar('\n');
+
+    return EXIT_SUCCESS;
+}
+
+
+static int utility_true(int argc, char *argv[]) {
+    return EXIT_SUCCESS;
+}
+
+
+static const entry_t utilities[] = {
+    { "cat",  utility_cat },
+    { "echo", utility_echo },
+    { "true", utility_true },
+};
+
+
+utility_t find_utility(const char *name) {
+    for (size_t i = 0; i < sizeof(utilities) / sizeof(utilities[0]); i++) {
+        if (strcmp(name, utilities[i].name) == 0) return utilities[i].run;
+    }
+
+    return NULL;
+}
+
+
+int run_utility(command_t *cmd) {
+    utility_t run = find_utility(cmd->args[0]);
+
+    if (run == NULL) {
+        /* we should never reach here */
+        return EXIT_FAILURE;
+    }
+
+    int status = run(cmd->argc, cmd->args);
+
+    /* anything started after this must not overtake what it printed */
+    fflush(stdout);
+    fflush(stderr);
+
+    return status;
+}
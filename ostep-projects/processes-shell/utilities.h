@@ -0,0 +1,36 @@
+#ifndef UTILITIES_H_
+#define UTILITIES_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+#include "structs.h"
+
+
+/**
+ * A utility built into the shell: a stand-in for a program on the path
+ * (cat, echo, true) that runs without a fork or an exec. It is called with
+ * the args of its command, its name first, and returns its exit status.
+ **/
+typedef int (*utility_t)(int, char**);
+
+
+/* finds a utility by name; NULL if there's none by that name */
+utility_t find_utility(const char*);
+
+
+/**
+ * Runs a utility command right here, in whatever process calls it, and
+ * flushes what it printed. Returns its exit status.
+ **/
+int run_utility(command_t*);
+
+#endif // UTILITIES_H_
@@ -10,6 +10,19 @@
 ** - Batch mode: The shell reads input from a batch file and executes
 **               commands from therein. Only a single .txt file in the current
 **               working directory may be passed as an argument.
+**               With `-j N` before it (`wish -j 8 script.txt`), up to N lines
+**               of the file run at a time, each one's output printed in one
+**               piece once it is done; a line with a lone built-in, such as
+**               `wait`, runs only once all the lines before it are done.
+**
+** - Timing: `time cmd ...` prints how long the command took, and the
+**           resources it used, once it's done. With `--stats`, a latency
+**           histogram and the time spent forking, exec'ing and waiting
+**           are printed when the shell exits.
+**
+** - Helpers: With `-z N` (in either mode), N processes are forked ahead of
+**            time and each is handed a command to exec when one is needed,
+**            with its descriptors passed over a socketpair.
 **
 ** - Paths: The user must specify a 'path' variable to describe the set of
 **          directories to search for executables.
@@ -19,7 +32,8 @@
 **                redirection is [command (args ...) > filename]. Multiple
 **                redirection operators or multiple files to the right of the
 **                redirection sign are errors.
-**                The redirection for build-in commands isn't full supported.
+**                Built-in commands run in the shell have their output
+**                redirected for as long as they run.
 **
 ** - Parallel Commands: The shell also allows the user to launch parallel commands.
 **                      This is accomplished with the ampersand operator as follows:
@@ -27,7 +41,11 @@
 **                      wish> cmd1 & cmd2 args1 args1 & cmd3 args1
 **                      ```
 **                      The shell will run all three commands in parallel and wait
-**                      on them to finish.
+**                      on them to finish. A line ending in '&' runs in the
+**                      background instead: the prompt comes right back, and the
+**                      'jobs' and 'wait [id]' built-ins list and wait for such
+**                      jobs. Children are reaped in the order they finish,
+**                      through a pidfd for each one and an epoll set.
 **
 ** - Program Errors: The shell only ever prints this one error message (as specified
 **                   under project specifications):
@@ -48,6 +66,8 @@
 **                              able to run any programs except the built-in commands.
 **                              The `path` commands always overwrites the old path with
 **                              the newly specififed path.
+**                      'cat', 'echo' and 'true' are built in too, and run without
+**                      a fork or an exec when they are on their own.
 */
 
 #include "wish.h"
@@ -55,20 +75,51 @@
 #define PROMPT "wish> "
 #define BATCH_MODE 1
 #define INTERACTIVE_MODE 0
+#define MAX_HELPERS 64          /* most helpers -z can ask for */
 
 int main(int argc, char *argv[]) {
-    /* shell accepts at most one argument */
-    if (argc > 2) {
+    long max_jobs = 0, num_helpers = 0;
+    int opt;
+    static const struct option long_options[] = {
+        { "stats", no_argument, NULL, 's' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    /* -j N runs up to N lines of a batch file at a time; -z N keeps N
+     * helpers forked ahead of time to start commands; --stats prints where
+     * the time went on exit; a bad option gets the shell's own error */
+    opterr = 0;
+
+    while ((opt = getopt_long(argc, argv, "j:z:", long_options, NULL)) != -1) {
+        char *end;
+        long *value = (opt == 'j') ? &max_jobs : (opt == 'z') ? &num_helpers : NULL;
+
+        if (opt == 's') {
+            init_stats();
+            continue;
+        }
+
+        if (value == NULL || (*value = strtol(optarg, &end, 10)) <= 0 || *end != '\0' ||
+            num_helpers > MAX_HELPERS) {
+            print_error();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* shell accepts at most one argument besides that, and -j needs a batch
+     * file; -j lines run in children of their own, where the pool's helpers
+     * (the shell's alone) would never be used, so -z doesn't go with it */
+    if (argc - optind > 1 || (max_jobs > 0 && (argc - optind != 1 || num_helpers > 0))) {
         print_error();
         exit(EXIT_FAILURE);
     }
 
-    int mode = (argc == 2) ? BATCH_MODE : INTERACTIVE_MODE;
+    int mode = (argc - optind == 1) ? BATCH_MODE : INTERACTIVE_MODE;
 
     FILE *input_stream;
 
     if (mode == BATCH_MODE) {
-        input_stream = fopen(argv[1], "r");
+        input_stream = fopen(argv[optind], "r");
         if (input_stream == NULL) {
             print_error();
             exit(EXIT_FAILURE);
@@ -77,7 +128,16 @@ int main(int argc, char *argv[]) {
         input_stream = stdin;
     }
 
-    run_shell(input_stream, mode);
+    if (num_helpers > 0 && !init_helpers(num_helpers)) {
+        print_error();
+        exit(EXIT_FAILURE);
+    }
+
+    if (max_jobs > 0) {
+        run_batch_parallel(input_stream, max_jobs);
+    } else {
+        run_shell(input_stream, mode);
+    }
 
     if (mode == BATCH_MODE) fclose(input_stream);
 
@@ -89,10 +149,25 @@ void run_shell(FILE *input_stream, int mode) {
     char *lineptr = NULL;
     size_t n = 0, line_size;
     path_t *path = init_default_path();
+    jobs_t *jobs = init_jobs();
+    arena_t arena;
+
+    if (jobs == NULL) {
+        print_error();
+        exit(EXIT_FAILURE);
+    }
+
+    init_arena(&arena);
 
     /* print the prompt and wait for user input */
     while (true) {
 
+        /* collect finished background jobs; the user hears about them here */
+        reap_jobs(jobs, mode == INTERACTIVE_MODE);
+
+        /* helpers used up by the last line are replaced while nothing runs */
+        refill_helpers();
+
         if (mode == INTERACTIVE_MODE) fprintf(stdout, PROMPT);
 
         errno = 0;
@@ -101,7 +176,10 @@ void run_shell(FILE *input_stream, int mode) {
             if (errno == 0) {
                 if (lineptr != NULL) free(lineptr);
                 if(path != NULL) free_path(path);
-                /* encountered EOF */
+                /* encountered EOF; let background jobs finish, as exit does */
+                wait_all_jobs(jobs);
+                free_jobs(jobs);
+                free_arena(&arena);
                 exit(EXIT_SUCCESS);
             }
             print_error();
@@ -115,30 +193,10 @@ void run_shell(FILE *input_stream, int mode) {
         }
 
 
-        /* Even though lineptr is guaranteed to be null terminated, we'll still
-         * err on the side of caution here */
-        char *linecpy = (char *) malloc(sizeof(char) * (line_size + 1));
-        strncpy(linecpy, lineptr, line_size); /* copy line */
-        linecpy[line_size - 1] = '\0';        /* null terminate line to be sure */
-
-        tokens_t *tokens = tokenize_line(&linecpy, line_size);
-
-        if (tokens == NULL) {
-            /* no valid tokens in line */
-            free(linecpy);
-            continue;
-        }
-
-        if (tokens->num == 1) {
-            /* execute the single command */
-            execute_command(linecpy, &path);
-        } else {
-            execute_commands_in_parallel(tokens, &path);
-        }
-
-
-        free(linecpy);
-        free_tokens(tokens);
+        /* the line is parsed where it is, and whatever parsing needs comes
+         * from the arena, which is emptied once the line has run */
+        execute_line(lineptr, &path, jobs, &arena);
+        reset_arena(&arena);
     }
 
     free(lineptr);
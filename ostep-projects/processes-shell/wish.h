@@ -9,6 +9,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <getopt.h>
 #include <string.h>
 
 /* External headers */
@@ -17,6 +18,9 @@
 #include "error.h"
 #include "structs.h"
 #include "tokens.h"
+#include "jobs.h"
+#include "batch.h"
+#include "stats.h"
 
 void run_shell(FILE*, int);
 